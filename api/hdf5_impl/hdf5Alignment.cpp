@@ -18,6 +18,7 @@
 #include <deque>
 #include <fstream>
 #include <iostream>
+#include <thread>
 extern "C" {
 #include "sonLibTree.h"
 }
@@ -47,7 +48,13 @@ const hsize_t Hdf5Alignment::DefaultCacheMDCElems = 113;
 const hsize_t Hdf5Alignment::DefaultCacheRDCElems = 521;
 const hsize_t Hdf5Alignment::DefaultCacheRDCBytes = 1048576;
 const double Hdf5Alignment::DefaultCacheW0 = 0.75;
+// split between the open genomes unless --hdf5CacheBytes is given
+const hsize_t Hdf5Alignment::DefaultCacheBudget = 64 * 1048576;
+const bool Hdf5Alignment::DefaultCacheStats = false;
+// 0 is one thread per core
+const hsize_t Hdf5Alignment::DefaultCompressionThreads = 0;
 const bool Hdf5Alignment::DefaultInMemory = false;
+const bool Hdf5Alignment::DefaultConcurrent = false;
 
 /* check if first bit of file has HDF5 header */
 bool hal::Hdf5Alignment::isHdf5File(const std::string &initialBytes) {
@@ -70,7 +77,9 @@ Hdf5Alignment::Hdf5Alignment(const string &alignmentPath, unsigned mode, const H
                              const H5::FileAccPropList &fileAccessProps, const H5::DSetCreatPropList &datasetCreateProps,
                              bool inMemory)
     : _alignmentPath(alignmentPath), _mode(halDefaultAccessMode(mode)), _file(NULL), _flags(hdf5DefaultFlags(_mode)),
-      _inMemory(inMemory), _metaData(NULL), _tree(NULL), _dirty(false) {
+      _inMemory(inMemory), _concurrent(false), _cacheBudget(0), _cacheW0(DefaultCacheW0),
+      _cacheTunedGenomes(0), _cacheStats(false), _compressionThreads(DefaultCompressionThreads), _compressor(NULL),
+      _metaData(NULL), _tree(NULL), _dirty(false) {
     _cprops.copy(fileCreateProps);
     _aprops.copy(fileAccessProps);
     _dcprops.copy(datasetCreateProps);
@@ -86,7 +95,9 @@ Hdf5Alignment::Hdf5Alignment(const string &alignmentPath, unsigned mode, const H
 
 Hdf5Alignment::Hdf5Alignment(const std::string &alignmentPath, unsigned mode, const CLParser *parser)
     : _alignmentPath(alignmentPath), _mode(halDefaultAccessMode(mode)), _file(NULL), _flags(hdf5DefaultFlags(_mode)),
-      _inMemory(false), _metaData(NULL), _tree(NULL), _dirty(false) {
+      _inMemory(false), _concurrent(false), _cacheBudget(0), _cacheW0(DefaultCacheW0),
+      _cacheTunedGenomes(0), _cacheStats(false), _compressionThreads(DefaultCompressionThreads), _compressor(NULL),
+      _metaData(NULL), _tree(NULL), _dirty(false) {
     initializeFromOptions(parser);
     if (_inMemory) {
         setInMemory();
@@ -109,6 +120,11 @@ void Hdf5Alignment::defineOptions(CLParser *parser, unsigned mode) {
 
         parser->addOption("hdf5Compression", "hdf5 compression factor [0:none - 9:max]", DefaultCompression);
         parser->addOption("deflate", "obsolete name for --hdf5Compression", DefaultCompression);
+
+        parser->addOption("hdf5CompressionThreads",
+                          "number of threads compressing hdf5 chunks as they are written (0: one per core, "
+                          "1: compress in the writing thread)",
+                          DefaultCompressionThreads);
     }
     parser->addOption("hdf5CacheMDC", "number of metadata slots in hdf5 cache", DefaultCacheMDCElems);
     parser->addOption("cacheMDC", "obsolete name for --hdf5CacheMDC ", DefaultCacheMDCElems);
@@ -124,8 +140,19 @@ void Hdf5Alignment::defineOptions(CLParser *parser, unsigned mode) {
     parser->addOption("hdf5CacheW0", "w0 parameter for hdf5 cache", DefaultCacheW0);
     parser->addOption("cacheW0", "obsolete name for --hdf5CacheW0", DefaultCacheW0);
 
+    parser->addOption("hdf5CacheBudget",
+                      "maximum size in bytes of the regular hdf5 caches of all open genomes together, "
+                      "used to size each dataset's cache from its chunk size unless --hdf5CacheBytes "
+                      "or --hdf5CacheRDC is given (0 to always use --hdf5CacheBytes)",
+                      DefaultCacheBudget);
+    parser->addOptionFlag("hdf5CacheStats", "print hdf5 cache statistics to stderr when closing the file",
+                          DefaultCacheStats);
+
     parser->addOptionFlag("hdf5InMemory", "load all data in memory (and disable hdf5 cache)", DefaultInMemory);
     parser->addOptionFlag("inMemory", "obsolete name for --hdf5InMemory", DefaultInMemory);
+    parser->addOptionFlag("hdf5Concurrent",
+                          "allow queries from several threads at once (read-only, opens all genomes up front)",
+                          DefaultConcurrent);
 }
 
 /* initialize class from options */
@@ -134,15 +161,22 @@ void Hdf5Alignment::initializeFromOptions(const CLParser *parser) {
     _dcprops.copy(H5::DSetCreatPropList::DEFAULT);
     _aprops.copy(H5::FileAccPropList::DEFAULT);
     _inMemory = parser->getFlagAlt("hdf5InMemory", "inMemory");
+    _concurrent = parser->getFlag("hdf5Concurrent") and not(_mode & WRITE_ACCESS);
     if ((_mode & CREATE_ACCESS) || (_mode & WRITE_ACCESS)) {
         // these are only available on create
         hsize_t chunk = parser->getOptionAlt<hsize_t>("hdf5Chunk", "chunk");
         _dcprops.setChunk(1, &chunk);
         _dcprops.setDeflate(parser->getOptionAlt<hsize_t>("hdf5Compression", "deflate"));
+        _compressionThreads = parser->getOption<hsize_t>("hdf5CompressionThreads");
     }
-    _aprops.setCache(
-        parser->getOptionAlt<hsize_t>("hdf5CacheMDC", "cacheMDC"), parser->getOptionAlt<hsize_t>("hdf5CacheRDC", "cacheRDC"),
-        parser->getOptionAlt<hsize_t>("hdf5CacheBytes", "cacheBytes"), parser->getOptionAlt<double>("hdf5CacheW0", "cacheW0"));
+    _cacheW0 = parser->getOptionAlt<double>("hdf5CacheW0", "cacheW0");
+    _aprops.setCache(parser->getOptionAlt<hsize_t>("hdf5CacheMDC", "cacheMDC"),
+                     parser->getOptionAlt<hsize_t>("hdf5CacheRDC", "cacheRDC"),
+                     parser->getOptionAlt<hsize_t>("hdf5CacheBytes", "cacheBytes"), _cacheW0);
+    bool fixedCache = parser->specifiedOption("hdf5CacheRDC") or parser->specifiedOption("cacheRDC") or
+                      parser->specifiedOption("hdf5CacheBytes") or parser->specifiedOption("cacheBytes");
+    _cacheBudget = fixedCache ? 0 : parser->getOption<hsize_t>("hdf5CacheBudget");
+    _cacheStats = parser->getFlag("hdf5CacheStats");
 }
 
 /* set properties for in-memory access */
@@ -152,6 +186,15 @@ void Hdf5Alignment::setInMemory() {
     double w0;
     _aprops.getCache(mdc, rdc, rdcb, w0);
     _aprops.setCache(mdc, 0, 0, 0.0);
+    _cacheBudget = 0;
+}
+
+/* start the chunk compression threads if writing */
+void Hdf5Alignment::initCompressor() {
+    size_t numThreads = _compressionThreads > 0 ? _compressionThreads : thread::hardware_concurrency();
+    if ((not isReadOnly()) and (numThreads > 1)) {
+        _compressor = new Hdf5ChunkCompressor(numThreads);
+    }
 }
 
 void Hdf5Alignment::create() {
@@ -160,6 +203,7 @@ void Hdf5Alignment::create() {
     }
 
     _file = new H5File(_alignmentPath.c_str(), _flags, _cprops, _aprops);
+    initCompressor();
     _file->createGroup(MetaGroupName);
     _file->createGroup(TreeGroupName);
     _file->createGroup(GenomesGroupName);
@@ -190,12 +234,74 @@ void Hdf5Alignment::open() {
         throw hal_exception("HAL API v" + HAL_VERSION + " incompatible with format v" + getVersion() + " HAL file.");
     }
 #endif
+    H5Freset_mdc_hit_rate_stats(_file->getId());
+    initCompressor();
     _metaData = new HDF5MetaData(_file, MetaGroupName);
     loadTree();
+    if (_concurrent) {
+        setConcurrentReads();
+    }
+}
+
+/* Open every genome and prepare it for lookups from several threads, so
+ * that openGenome() only reads the map of open genomes */
+void Hdf5Alignment::setConcurrentReads() {
+    for (const auto &node : _nodeMap) {
+        openGenome(node.first);
+    }
+    for (const auto &genome : _openGenomes) {
+        genome.second->setConcurrentReads();
+    }
+}
+
+/* Give each open genome an equal share of the chunk cache budget.  Shares
+ * are sized for the number of open genomes rounded up to a power of two,
+ * so genomes already open are only resized when that number doubles. */
+void Hdf5Alignment::tuneChunkCaches(Hdf5Genome *genome) {
+    if (_openGenomes.size() > _cacheTunedGenomes) {
+        while (_cacheTunedGenomes < _openGenomes.size()) {
+            _cacheTunedGenomes = max(_cacheTunedGenomes * 2, size_t(1));
+        }
+        for (const auto &openGenome : _openGenomes) {
+            openGenome.second->setChunkCacheBudget(_cacheBudget / _cacheTunedGenomes, _cacheW0);
+        }
+    } else {
+        genome->setChunkCacheBudget(_cacheBudget / _cacheTunedGenomes, _cacheW0);
+    }
+}
+
+Hdf5CacheStats Hdf5Alignment::getCacheStats() const {
+    Hdf5CacheStats stats;
+    H5Fget_mdc_hit_rate(_file->getId(), &stats._mdcHitRate);
+    size_t minCleanBytes;
+    H5Fget_mdc_size(_file->getId(), &stats._mdcMaxBytes, &minCleanBytes, &stats._mdcCurBytes, &stats._mdcEntries);
+    stats._numOpenGenomes = _openGenomes.size();
+    stats._chunkCacheBytes = 0;
+    stats._arrays = _closedArrayStats;
+    for (const auto &genome : _openGenomes) {
+        stats._chunkCacheBytes += genome.second->getChunkCacheBytes();
+        stats._arrays += genome.second->getArrayStats();
+    }
+    return stats;
+}
+
+void Hdf5Alignment::printCacheStats(ostream &os) const {
+    Hdf5CacheStats stats = getCacheStats();
+    os << "hdf5 cache statistics for " << _alignmentPath << endl
+       << "  metadata cache: hit rate " << stats._mdcHitRate << ", " << stats._mdcCurBytes << " of "
+       << stats._mdcMaxBytes << " bytes in " << stats._mdcEntries << " entries" << endl
+       << "  chunk caches: " << stats._chunkCacheBytes << " bytes for " << stats._numOpenGenomes << " open genomes"
+       << (_cacheBudget > 0 ? "" : " (not budgeted)") << endl
+       << "  array windows: " << stats._arrays._windowLoads << " loads, " << stats._arrays._windowEvictions
+       << " evictions, " << stats._arrays._bytesRead << " bytes read, " << stats._arrays._bytesWritten
+       << " bytes written" << endl;
 }
 
 void Hdf5Alignment::close() {
     if (_file != NULL) {
+        if (_cacheStats) {
+            printCacheStats(cerr);
+        }
         if (not isReadOnly()) {
             writeTree();
         }
@@ -222,6 +328,8 @@ void Hdf5Alignment::close() {
             delete genome;
         }
         _openGenomes.clear();
+        delete _compressor;
+        _compressor = NULL;
         if (not isReadOnly()) {
             _file->flush(H5F_SCOPE_LOCAL);
         }
@@ -421,6 +529,9 @@ Genome *Hdf5Alignment::openGenome(const string &name) {
     if (_nodeMap.find(name) != _nodeMap.end()) {
         genome = new Hdf5Genome(name, this, _file, _dcprops, _inMemory);
         _openGenomes.insert(pair<string, Hdf5Genome *>(name, genome));
+        if (_cacheBudget > 0) {
+            tuneChunkCaches(genome);
+        }
     }
     return genome;
 }
@@ -433,6 +544,7 @@ void Hdf5Alignment::closeGenome(const Genome *genome) const {
                             "Should not even be possible");
     }
     mapIt->second->write();
+    _closedArrayStats += mapIt->second->getArrayStats();
     delete mapIt->second;
     _openGenomes.erase(mapIt);
 
@@ -10,6 +10,7 @@
 
 #include "halAlignmentInstance.h"
 #include "hdf5Alignment.h"
+#include "hdf5ChunkCompressor.h"
 #include "hdf5Genome.h"
 #include "hdf5MetaData.h"
 #include <H5Cpp.h>
@@ -20,6 +21,24 @@ typedef struct _stTree stTree;
 namespace hal {
 
     class Hdf5Genome;
+
+    /**
+     * Cache statistics of an open HDF5 alignment
+     */
+    struct Hdf5CacheStats {
+        /** metadata cache hit rate since the file was opened */
+        double _mdcHitRate;
+        size_t _mdcMaxBytes;
+        size_t _mdcCurBytes;
+        int _mdcEntries;
+        size_t _numOpenGenomes;
+        /** chunk cache bytes given to the open genomes by the cache
+         * budget, 0 if chunk caches are sized by --hdf5CacheBytes */
+        hsize_t _chunkCacheBytes;
+        /** reads and writes of all genomes opened so far */
+        Hdf5ArrayStats _arrays;
+    };
+
     /**
      * HDF5 implementation of hal::Alignment
      */
@@ -83,6 +102,15 @@ namespace hal {
 
         void replaceNewickTree(const std::string &newNewickString);
 
+        // HDF5 SPECIFIC
+        Hdf5CacheStats getCacheStats() const;
+        void printCacheStats(std::ostream &os) const;
+        /* threads compressing chunks written to the file, or NULL if HDF5
+         * compresses them in the writing thread */
+        Hdf5ChunkCompressor *getChunkCompressor() const {
+            return _compressor;
+        }
+
       private:
         // FIXME: should these be private?
         void loadTree();
@@ -100,6 +128,9 @@ namespace hal {
         void create();
         void open();
         void setInMemory();
+        void setConcurrentReads();
+        void tuneChunkCaches(Hdf5Genome *genome);
+        void initCompressor();
 
       public:
         static const hsize_t DefaultChunkSize;
@@ -108,7 +139,11 @@ namespace hal {
         static const hsize_t DefaultCacheRDCElems;
         static const hsize_t DefaultCacheRDCBytes;
         static const double DefaultCacheW0;
+        static const hsize_t DefaultCacheBudget;
+        static const bool DefaultCacheStats;
+        static const hsize_t DefaultCompressionThreads;
         static const bool DefaultInMemory;
+        static const bool DefaultConcurrent;
 
         static const H5std_string MetaGroupName;
         static const H5std_string TreeGroupName;
@@ -122,6 +157,14 @@ namespace hal {
         H5::H5File *_file;
         int _flags;
         bool _inMemory;
+        bool _concurrent;
+        hsize_t _cacheBudget;
+        double _cacheW0;
+        size_t _cacheTunedGenomes;
+        bool _cacheStats;
+        mutable Hdf5ArrayStats _closedArrayStats;
+        hsize_t _compressionThreads;
+        Hdf5ChunkCompressor *_compressor;
         H5::FileCreatPropList _cprops;
         H5::FileAccPropList _aprops;
         H5::DSetCreatPropList _dcprops;
@@ -9,6 +9,7 @@
 #include "hdf5Genome.h"
 #include "hdf5TopSegment.h"
 #include <cstdlib>
+#include <cstring>
 #include <string>
 
 using namespace std;
@@ -83,3 +84,48 @@ H5::CompType Hdf5BottomSegment::dataType(hal_size_t numChildren) {
     }
     return dataType;
 }
+
+/* Elements are read with the one after the last segment, which holds its
+ * end position.  Fields are copied with memcpy as elements are packed. */
+void Hdf5BottomSegment::readBlock(Hdf5ExternalArray *array, hal_size_t numChildren, hal_index_t first, hal_size_t count,
+                                  SegmentBlock &block) {
+    block.resize(first, count, false, numChildren);
+    size_t elementSize = totalSize(numChildren);
+    vector<char> elements((count + 1) * elementSize);
+    array->read(first, count + 1, elements.data());
+    for (hal_size_t i = 0; i < count; ++i) {
+        const char *element = elements.data() + i * elementSize;
+        memcpy(&block._startPositions[i], element + genomeIndexOffset, sizeof(hal_index_t));
+        memcpy(&block._parseIndexes[i], element + topIndexOffset, sizeof(hal_index_t));
+        for (hal_size_t child = 0; child < numChildren; ++child) {
+            const char *link = element + firstChildOffset + child * (sizeof(hal_index_t) + sizeof(bool));
+            memcpy(&block._linkIndexes[i * numChildren + child], link, sizeof(hal_index_t));
+            block._reversed[i * numChildren + child] = link[sizeof(hal_index_t)];
+        }
+    }
+    memcpy(&block._startPositions[count], elements.data() + count * elementSize + genomeIndexOffset, sizeof(hal_index_t));
+}
+
+/* The element after the last segment is left to the next block, unless it
+ * is the one at the end of the array that only holds an end position. */
+void Hdf5BottomSegment::writeBlock(Hdf5ExternalArray *array, const SegmentBlock &block) {
+    hal_size_t count = block.getNumSegments();
+    hal_size_t numChildren = block._numChildren;
+    size_t elementSize = totalSize(numChildren);
+    hal_size_t numElements = (block._first + count + 1 == array->getSize()) ? count + 1 : count;
+    vector<char> elements(numElements * elementSize, 0);
+    for (hal_size_t i = 0; i < count; ++i) {
+        char *element = elements.data() + i * elementSize;
+        memcpy(element + genomeIndexOffset, &block._startPositions[i], sizeof(hal_index_t));
+        memcpy(element + topIndexOffset, &block._parseIndexes[i], sizeof(hal_index_t));
+        for (hal_size_t child = 0; child < numChildren; ++child) {
+            char *link = element + firstChildOffset + child * (sizeof(hal_index_t) + sizeof(bool));
+            memcpy(link, &block._linkIndexes[i * numChildren + child], sizeof(hal_index_t));
+            link[sizeof(hal_index_t)] = block._reversed[i * numChildren + child] ? 1 : 0;
+        }
+    }
+    if (numElements > count) {
+        memcpy(elements.data() + count * elementSize + genomeIndexOffset, &block._startPositions[count], sizeof(hal_index_t));
+    }
+    array->write(block._first, numElements, elements.data());
+}
@@ -56,6 +56,14 @@ namespace hal {
         static H5::CompType dataType(hal_size_t numChildren);
         static hal_size_t numChildrenFromDataType(const H5::DataType &dataType);
 
+        /* read segments first to first + count - 1 of an array with
+         * numChildren children per segment into a block */
+        static void readBlock(Hdf5ExternalArray *array, hal_size_t numChildren, hal_index_t first, hal_size_t count,
+                              SegmentBlock &block);
+
+        /* write the segments of a block to an array */
+        static void writeBlock(Hdf5ExternalArray *array, const SegmentBlock &block);
+
       private:
         Hdf5Genome *getHdf5Genome() const {
             return static_cast<Hdf5Genome *>(_genome);
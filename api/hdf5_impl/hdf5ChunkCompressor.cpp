@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "hdf5ChunkCompressor.h"
+#include "halDefs.h"
+#include <memory>
+#include <zlib.h>
+
+using namespace hal;
+using namespace std;
+
+Hdf5ChunkCompressor::Hdf5ChunkCompressor(size_t numThreads) : _stop(false) {
+    for (size_t i = 0; i < numThreads; i++) {
+        _workers.push_back(thread(&Hdf5ChunkCompressor::worker, this));
+    }
+}
+
+Hdf5ChunkCompressor::~Hdf5ChunkCompressor() {
+    {
+        lock_guard<mutex> guard(_mutex);
+        _stop = true;
+    }
+    _queueReady.notify_all();
+    for (thread &worker : _workers) {
+        worker.join();
+    }
+}
+
+/* deflate a chunk into a zlib stream, as H5Z_FILTER_DEFLATE does */
+static Hdf5ChunkCompressor::Buffer deflateChunk(const Hdf5ChunkCompressor::Buffer &chunk, int level) {
+    uLongf compressedSize = compressBound(chunk.size());
+    Hdf5ChunkCompressor::Buffer compressed(compressedSize);
+    int status = compress2(reinterpret_cast<Bytef *>(compressed.data()), &compressedSize,
+                           reinterpret_cast<const Bytef *>(chunk.data()), chunk.size(), level);
+    if (status != Z_OK) {
+        throw hal_exception("zlib error " + std::to_string(status) + " compressing hdf5 chunk");
+    }
+    compressed.resize(compressedSize);
+    return compressed;
+}
+
+future<Hdf5ChunkCompressor::Buffer> Hdf5ChunkCompressor::compress(Buffer chunk, int level) {
+    // C++11 lambdas can't capture by move
+    auto sharedChunk = make_shared<Buffer>(move(chunk));
+    packaged_task<Buffer()> task([sharedChunk, level]() { return deflateChunk(*sharedChunk, level); });
+    future<Buffer> compressed = task.get_future();
+    {
+        lock_guard<mutex> guard(_mutex);
+        _queue.push_back(move(task));
+    }
+    _queueReady.notify_one();
+    return compressed;
+}
+
+/* compress queued chunks until stopped, finishing the queue first */
+void Hdf5ChunkCompressor::worker() {
+    while (true) {
+        packaged_task<Buffer()> task;
+        {
+            unique_lock<mutex> lock(_mutex);
+            _queueReady.wait(lock, [this] { return _stop or not _queue.empty(); });
+            if (_queue.empty()) {
+                return;
+            }
+            task = move(_queue.front());
+            _queue.pop_front();
+        }
+        task();
+    }
+}
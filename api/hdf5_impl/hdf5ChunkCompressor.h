@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HDF5CHUNKCOMPRESSOR_H
+#define _HDF5CHUNKCOMPRESSOR_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace hal {
+
+    /**
+     * Pool of threads compressing chunks of HDF5 datasets with zlib, giving
+     * the same bytes as the HDF5 deflate filter.  Writers keep several chunks
+     * in flight and write each with a direct chunk write once compressed, so
+     * compression runs on all cores rather than in the writing thread.  The
+     * threads only call zlib, never HDF5.
+     */
+    class Hdf5ChunkCompressor {
+      public:
+        typedef std::vector<char> Buffer;
+
+        Hdf5ChunkCompressor(size_t numThreads);
+
+        /* waits for queued chunks to be compressed */
+        ~Hdf5ChunkCompressor();
+
+        size_t getNumThreads() const {
+            return _workers.size();
+        }
+
+        /* queue a chunk to be compressed at a deflate level [0-9] */
+        std::future<Buffer> compress(Buffer chunk, int level);
+
+      private:
+        void worker();
+
+        std::mutex _mutex;                            // protects queue
+        std::condition_variable _queueReady;          // signalled when a chunk is queued or on stop
+        std::deque<std::packaged_task<Buffer()>> _queue; // chunks waiting for a thread
+        bool _stop;
+        std::vector<std::thread> _workers;
+    };
+}
+#endif
+// Local Variables:
+// mode: c++
+// End:
@@ -5,32 +5,68 @@
  * Released under the MIT license, see LICENSE.txt
  */
 #include "hdf5DnaDriver.h"
-#include "hdf5Alignment.h"
-#include "hdf5Genome.h"
+#include "hdf5ExternalArray.h"
+#include <algorithm>
 
 using namespace hal;
+using namespace std;
 
-HDF5DnaAccess::HDF5DnaAccess(Hdf5Genome *genome, Hdf5ExternalArray *dnaArray, hal_index_t index)
-    : DnaAccess(0, 0, NULL), _dnaArray(dnaArray) {
-    fetch(index);
+HDF5DnaPageCache::HDF5DnaPageCache(Hdf5ExternalArray *dnaArray) : _dnaArray(dnaArray) {
+}
+
+hsize_t HDF5DnaPageCache::getPageSize() const {
+    if (_dnaArray->getWindowSize() == 0) {
+        throw hal_exception("genome has no DNA");
+    }
+    return _dnaArray->getWindowSize();
+}
+
+HDF5DnaPageCache::PagePtr HDF5DnaPageCache::getPage(hsize_t pageIndex) {
+    lock_guard<mutex> guard(_mutex);
+    for (auto it = _cache.begin(); it != _cache.end(); ++it) {
+        if (it->first == pageIndex) {
+            _cache.splice(_cache.begin(), _cache, it);
+            return it->second;
+        }
+    }
+    hsize_t pageSize = getPageSize();
+    hsize_t start = pageIndex * pageSize;
+    if (start >= _dnaArray->getSize()) {
+        throw hal_exception("DNA position " + std::to_string(2 * start) + " out of range");
+    }
+    PagePtr page(new vector<char>(min(pageSize, _dnaArray->getSize() - start)));
+    _dnaArray->read(start, page->size(), page->data());
+    _cache.push_front(make_pair(pageIndex, page));
+    if (_cache.size() > HDF5_DNA_PAGE_CACHE_SIZE) {
+        _cache.pop_back();
+    }
+    return page;
+}
+
+void HDF5DnaPageCache::writePage(hsize_t pageIndex, const vector<char> &page) {
+    _dnaArray->write(pageIndex * getPageSize(), page.size(), page.data());
+}
+
+HDF5DnaAccess::HDF5DnaAccess(HDF5DnaPageCache *pageCache) : DnaAccess(0, 0, NULL), _pageCache(pageCache), _pageIndex(0) {
+    // first page is read on first access
 }
 
 void HDF5DnaAccess::flush() {
-    // ensure that marked dirty
     if (_dirty) {
-        _dnaArray->setDirty();
+        _pageCache->writePage(_pageIndex, *_page);
     }
     _dirty = false;
 }
 
 void HDF5DnaAccess::fetch(hal_index_t index) const {
     if (_dirty) {
-        _dnaArray->setDirty();
+        _pageCache->writePage(_pageIndex, *_page);
+        _dirty = false;
     }
-    _dnaArray->page(index / 2);
-    // DANGER _dnaArray is close-ended
-    _startIndex = 2 * _dnaArray->getBufStart();
-    _endIndex = 2 * (_dnaArray->getBufEnd() + 1);
-    _buffer = _dnaArray->getBuf();
-    _dirty = false;
+    hsize_t pageSize = _pageCache->getPageSize();
+    _pageIndex = (index / 2) / pageSize;
+    _page = _pageCache->getPage(_pageIndex);
+    _startIndex = 2 * _pageIndex * pageSize;
+    _endIndex = _startIndex + 2 * _page->size();
+    _buffer = _page->data();
 }
@@ -7,17 +7,58 @@
 #ifndef _HDF5DNADRIVER_H
 #define _HDF5DNADRIVER_H
 #include "halDnaDriver.h"
+#include <H5Cpp.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace hal {
-    class Hdf5Genome;
     class Hdf5ExternalArray;
 
+    /* number of DNA pages cached per genome */
+    static const size_t HDF5_DNA_PAGE_CACHE_SIZE = 8;
+
+    /**
+     * Pages of a genome's nibble-packed DNA array, each the size of the
+     * array's window (normally one chunk).  Recently used pages are kept in
+     * an LRU cache shared by the genome's DnaAccess objects, so accesses at
+     * distant positions each keep their own page rather than re-reading a
+     * single shared buffer.  Getting a page is thread-safe.
+     */
+    class HDF5DnaPageCache {
+      public:
+        typedef std::shared_ptr<std::vector<char>> PagePtr;
+
+        HDF5DnaPageCache(Hdf5ExternalArray *dnaArray);
+
+        /* drop cached pages, after the array has been recreated */
+        void clear() {
+            std::lock_guard<std::mutex> guard(_mutex);
+            _cache.clear();
+        }
+
+        /* number of array elements (two bases each) in a page */
+        hsize_t getPageSize() const;
+
+        /* get a page, reading it if not cached */
+        PagePtr getPage(hsize_t pageIndex);
+
+        /* write a modified page back to the array */
+        void writePage(hsize_t pageIndex, const std::vector<char> &page);
+
+      private:
+        Hdf5ExternalArray *_dnaArray;
+        std::mutex _mutex;                             // protects _cache
+        std::list<std::pair<hsize_t, PagePtr>> _cache; // most recently used first
+    };
+
     /**
      * HDF5 implementation of DnaAccess.
      */
     class HDF5DnaAccess : public DnaAccess {
       public:
-        HDF5DnaAccess(Hdf5Genome *genome, Hdf5ExternalArray *dnaArray, hal_index_t index);
+        HDF5DnaAccess(HDF5DnaPageCache *pageCache);
 
         virtual ~HDF5DnaAccess() {
         }
@@ -28,7 +69,9 @@ namespace hal {
         virtual void fetch(hal_index_t index) const;
 
       private:
-        Hdf5ExternalArray *_dnaArray;
+        HDF5DnaPageCache *_pageCache;
+        mutable hsize_t _pageIndex;
+        mutable HDF5DnaPageCache::PagePtr _page; // current page, kept even if evicted from cache
     };
 }
 
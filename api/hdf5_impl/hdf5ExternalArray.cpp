@@ -6,136 +6,323 @@
  */
 
 #include "hdf5ExternalArray.h"
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <iostream>
+#include <mutex>
+#include <unordered_map>
+
+#if !H5_VERSION_GE(1, 10, 3)
+#include <H5DOpublic.h>
+#endif
 
 using namespace hal;
 using namespace H5;
 using namespace std;
 
+/* source of array ids, which are never reused */
+static atomic<uint64_t> nextArrayId(1);
+
+/* HDF5 reads and writes made through arrays are serialized, so arrays may
+ * be read from several threads whether or not the HDF5 library was built
+ * thread-safe */
+static mutex hdf5IoMutex;
+
 /** Constructor */
 Hdf5ExternalArray::Hdf5ExternalArray()
-    : _file(NULL), _size(0), _chunkSize(0), _bufStart(0), _bufEnd(0), _bufSize(0), _buf(NULL), _dirty(false) {
+    : _file(NULL), _size(0), _dataSize(0), _chunkBytes(0), _id(nextArrayId++), _concurrent(false), _compressor(NULL),
+      _deflateLevel(0), _windowLoads(0), _windowEvictions(0), _bytesRead(0), _bytesWritten(0) {
 }
 
 /** Destructor */
 Hdf5ExternalArray::~Hdf5ExternalArray() {
-    delete[] _buf;
 }
 
-/* initialize the internal data buffer */
-void Hdf5ExternalArray::initBuf() {
-    _bufSize = _chunkSize > 1 ? _chunkSize : _size;
-    _bufStart = 0;
-    _bufEnd = _bufSize - 1;
-    delete[] _buf;
-    _buf = new char[_bufSize * _dataSize];
+/* Size the in-memory window: whole array if chunksInBuffer is 0, otherwise
+ * chunksInBuffer chunks, or a fixed number of bytes if not chunked.  No
+ * memory is allocated until an element is accessed. */
+void Hdf5ExternalArray::initWindow(const DSetCreatPropList &cparms, hsize_t chunksInBuffer) {
+    hsize_t chunkSize = 0;
+    if (cparms.getLayout() == H5D_CHUNKED) {
+        cparms.getChunk(1, &chunkSize);
+    }
+    _chunkBytes = chunkSize * _dataSize;
+    hsize_t windowSize = _size;
+    if (chunksInBuffer > 0) {
+        if (chunkSize > 0) {
+            windowSize = chunkSize * chunksInBuffer;
+        } else {
+            windowSize = max(HDF5_CONTIGUOUS_WINDOW_BYTES / _dataSize, hsize_t(1));
+        }
+    }
+    _window.reset(min(windowSize, _size), _dataSize);
+    _windowLoads = _windowEvictions = _bytesRead = _bytesWritten = 0;
+}
+
+/* Use the compressor only for chunked datasets whose sole filter is
+ * deflate, as the chunks written directly must be what HDF5 would write */
+void Hdf5ExternalArray::initCompressor(const DSetCreatPropList &cparms, Hdf5ChunkCompressor *compressor) {
+    _compressor = NULL;
+    if ((compressor != NULL) and (_chunkBytes > 0) and (cparms.getNfilters() == 1)) {
+        unsigned int flags, filterConfig, cdValues[1];
+        size_t numCdValues = 1;
+        char name[1];
+        if (cparms.getFilter(0, flags, numCdValues, cdValues, 0, name, filterConfig) == H5Z_FILTER_DEFLATE) {
+            _compressor = compressor;
+            _deflateLevel = cdValues[0];
+        }
+    }
+}
+
+/* smallest prime >= n, for the number of chunk cache hash slots */
+static hsize_t nextPrime(hsize_t n) {
+    for (;; ++n) {
+        bool prime = n > 1;
+        for (hsize_t d = 2; prime and d * d <= n; ++d) {
+            prime = (n % d) != 0;
+        }
+        if (prime) {
+            return n;
+        }
+    }
+}
+
+// Reopen the dataset with a chunk cache sized for a number of chunks
+hsize_t Hdf5ExternalArray::setChunkCache(hsize_t numChunks, double w0) {
+    if (_chunkBytes == 0) {
+        return 0;
+    }
+    write();
+    hsize_t chunkSize = _chunkBytes / _dataSize;
+    numChunks = min(numChunks, (_size + chunkSize - 1) / chunkSize);
+    // HDF5 advises about 100 hash slots per cached chunk, fewer is fine
+    // as long as there are enough to avoid most collisions
+    DSetAccPropList dapl;
+    dapl.setChunkCache(nextPrime(10 * numChunks + 1), numChunks * _chunkBytes, w0);
+    lock_guard<mutex> guard(hdf5IoMutex);
+    _dataSet = _file->openDataSet(_path, dapl);
+    return numChunks * _chunkBytes;
+}
+
+// Get reads and writes made through the array
+Hdf5ArrayStats Hdf5ExternalArray::getStats() const {
+    Hdf5ArrayStats stats;
+    stats._windowLoads = _windowLoads;
+    stats._windowEvictions = _windowEvictions;
+    stats._bytesRead = _bytesRead;
+    stats._bytesWritten = _bytesWritten;
+    return stats;
 }
 
 // Create a new dataset in specifed location
 void Hdf5ExternalArray::create(PortableH5Location *file, const H5std_string &path, const DataType &dataType,
-                               hsize_t numElements, const DSetCreatPropList *inCparms, hsize_t chunksInBuffer) {
+                               hsize_t numElements, const DSetCreatPropList *inCparms, hsize_t chunksInBuffer,
+                               Hdf5ChunkCompressor *compressor) {
+    writePendingChunks(0, _size);
     // copy in parameters
     _file = file;
     _path = path;
     _dataType = dataType;
     _size = numElements;
     _dataSize = _dataType.getSize();
-    _dataSpace = DataSpace(1, &_size);
+    DataSpace dataSpace(1, &_size);
 
     DSetCreatPropList cparms;
     if (inCparms) {
         cparms.copy(*inCparms);
     }
 
-    // resolve chunking size (0 = do not chunk)
+    // resolve chunking size
     if (cparms.getLayout() == H5D_CHUNKED) {
-        cparms.getChunk(1, &_chunkSize);
+        hsize_t chunkSize;
+        cparms.getChunk(1, &chunkSize);
         // don't support chunking when size=1
         if (_size == 1) {
             cparms = DSetCreatPropList();
-            _chunkSize = 0;
         }
         // something's wrong with the input chunk size.  do one chunk.
-        else if (_chunkSize <= 1 || _chunkSize >= _size) {
-            _chunkSize = _size;
-            cparms.setChunk(1, &_chunkSize);
+        else if (chunkSize <= 1 || chunkSize >= _size) {
+            chunkSize = _size;
+            cparms.setChunk(1, &chunkSize);
         }
-        _chunkSize *= chunksInBuffer;
-    } else {
-        _chunkSize = 0;
     }
-
-    // create the internal data buffer
-    initBuf();
+    initWindow(cparms, chunksInBuffer);
+    initCompressor(cparms, compressor);
 
     // create the hdf5 array
-    _dataSet = _file->createDataSet(_path, _dataType, _dataSpace, cparms);
-    _chunkSpace = DataSpace(1, &_bufSize);
+    _dataSet = _file->createDataSet(_path, _dataType, dataSpace, cparms);
     assert(getSize() == numElements);
-    assert(_bufSize > 0 || _size == 0);
 }
 
-// Load an existing dataset into memory
-void Hdf5ExternalArray::load(PortableH5Location *file, const H5std_string &path, hsize_t chunksInBuffer) {
+// Load an existing dataset
+void Hdf5ExternalArray::load(PortableH5Location *file, const H5std_string &path, hsize_t chunksInBuffer,
+                             Hdf5ChunkCompressor *compressor) {
+    writePendingChunks(0, _size);
     // load up the parameters
     _file = file;
     _path = path;
     _dataSet = _file->openDataSet(_path);
     _dataType = _dataSet.getDataType();
-    _dataSpace = _dataSet.getSpace();
+    DataSpace dataSpace = _dataSet.getSpace();
     _dataSize = _dataType.getSize();
-    assert(_dataSpace.getSimpleExtentNdims() == 1);
-    _dataSpace.getSimpleExtentDims(&_size, NULL);
-    DSetCreatPropList cparms;
-    cparms.copy(_dataSet.getCreatePlist());
-
-    // resolve chunking size (0 = do not chunk)
-    if (cparms.getLayout() == H5D_CHUNKED) {
-        cparms.getChunk(1, &_chunkSize);
-        _chunkSize *= chunksInBuffer;
-        if (_chunkSize == 1) {
-            throw hal_exception("Hdf5ExternalArray::create: "
-                                "chunkSize of 1 not supported");
-        }
-        if (_chunkSize > _size) {
-            throw hal_exception("Hdf5ExternalArray::create: "
-                                "chunkSize > array size is not supported");
-        }
-    } else {
-        _chunkSize = 0;
-    }
-    initBuf();
-    _bufStart = _bufEnd + 1; // set out of range to ensure page happens
-    _chunkSpace = DataSpace(1, &_bufSize);
-    assert(_bufSize > 0 || _size == 0);
+    assert(dataSpace.getSimpleExtentNdims() == 1);
+    dataSpace.getSimpleExtentDims(&_size, NULL);
+    DSetCreatPropList cparms = _dataSet.getCreatePlist();
+    initWindow(cparms, chunksInBuffer);
+    initCompressor(cparms, compressor);
 }
 
 // Write the memory buffer back to the file
 void Hdf5ExternalArray::write() {
-    if (_dirty) {
-        _dataSpace.selectHyperslab(H5S_SELECT_SET, &_bufSize, &_bufStart);
-        _dataSet.write(_buf, _dataType, _chunkSpace, _dataSpace);
-        _dirty = false;
+    if (_window.getDirty()) {
+        write(_window.getStart(), _window.getEnd() - _window.getStart(), _window.getBuf());
+        _window.setDirty(false);
     }
+    writePendingChunks(0, _size);
 }
 
-// Page chunk containing index i into memory
-void Hdf5ExternalArray::page(hsize_t i) {
-    if (_dirty) {
-        write();
+// Read elements from the file into a caller's buffer
+void Hdf5ExternalArray::read(hsize_t start, hsize_t count, char *buf) {
+    if (_window.getDirty() and (start < _window.getEnd()) and (_window.getStart() < start + count)) {
+        write(_window.getStart(), _window.getEnd() - _window.getStart(), _window.getBuf());
+        _window.setDirty(false);
     }
-    _bufStart = (i / _bufSize) * _bufSize; // todo: review
-    _bufEnd = _bufStart + _bufSize - 1;
+    writePendingChunks(start, start + count);
+    _bytesRead += count * _dataSize;
+    lock_guard<mutex> guard(hdf5IoMutex);
+    DataSpace fileSpace = _dataSet.getSpace();
+    fileSpace.selectHyperslab(H5S_SELECT_SET, &count, &start);
+    DataSpace memSpace(1, &count);
+    _dataSet.read(buf, _dataType, memSpace, fileSpace);
+}
+
+/* Write elements from a caller's buffer to the file.  With a compressor,
+ * chunks wholly in the range, and the last chunk of the array if the
+ * range reaches the end, are queued; the partial chunks either side are
+ * written now, after any queued writes to them. */
+void Hdf5ExternalArray::write(hsize_t start, hsize_t count, const char *buf) {
+    _bytesWritten += count * _dataSize;
+    hsize_t end = start + count;
+    if ((buf != _window.getBuf()) and (start < _window.getEnd()) and (_window.getStart() < end)) {
+        hsize_t first = max(start, _window.getStart()), last = min(end, _window.getEnd());
+        copy(buf + (first - start) * _dataSize, buf + (last - start) * _dataSize, _window.getElement(first));
+    }
+    hsize_t chunkSize = _chunkBytes / max(_dataSize, hsize_t(1));
+    hsize_t firstChunk = 0, endChunk = 0;
+    if (_compressor != NULL) {
+        firstChunk = (start + chunkSize - 1) / chunkSize;
+        endChunk = (end == _size) ? (end + chunkSize - 1) / chunkSize : end / chunkSize;
+    }
+    if (firstChunk >= endChunk) {
+        writePendingChunks(start, end);
+        writeRange(start, count, buf);
+        return;
+    }
+    hsize_t chunkedStart = firstChunk * chunkSize, chunkedEnd = min(endChunk * chunkSize, end);
+    if (start < chunkedStart) {
+        writePendingChunks(start, chunkedStart);
+        writeRange(start, chunkedStart - start, buf);
+    }
+    for (hsize_t chunkIndex = firstChunk; chunkIndex < endChunk; ++chunkIndex) {
+        hsize_t chunkStart = chunkIndex * chunkSize;
+        queueChunk(chunkIndex, buf + (chunkStart - start) * _dataSize, min(chunkSize, _size - chunkStart));
+    }
+    if (chunkedEnd < end) {
+        writePendingChunks(chunkedEnd, end);
+        writeRange(chunkedEnd, end - chunkedEnd, buf + (chunkedEnd - start) * _dataSize);
+    }
+}
+
+// Write elements through the dataset's filters
+void Hdf5ExternalArray::writeRange(hsize_t start, hsize_t count, const char *buf) {
+    lock_guard<mutex> guard(hdf5IoMutex);
+    DataSpace fileSpace = _dataSet.getSpace();
+    fileSpace.selectHyperslab(H5S_SELECT_SET, &count, &start);
+    DataSpace memSpace(1, &count);
+    _dataSet.write(buf, _dataType, memSpace, fileSpace);
+}
 
-    if (_bufEnd >= _size) {
-        _bufEnd = _size - 1;
-        _bufSize = _bufEnd - _bufStart + 1;
-        _chunkSpace = DataSpace(1, &_bufSize);
+/* Queue a chunk of count elements (less than a chunk only at the end of the
+ * array, where it is padded) to be compressed.  Chunks already compressed
+ * are written, and the writer waits for the oldest chunk if each thread
+ * has two chunks queued. */
+void Hdf5ExternalArray::queueChunk(hsize_t chunkIndex, const char *buf, hsize_t count) {
+    Hdf5ChunkCompressor::Buffer chunk(_chunkBytes, 0);
+    copy(buf, buf + count * _dataSize, chunk.begin());
+    PendingChunk pending = {chunkIndex, _compressor->compress(move(chunk), _deflateLevel)};
+    _pendingChunks.push_back(move(pending));
+    while ((not _pendingChunks.empty()) and
+           ((_pendingChunks.size() > 2 * _compressor->getNumThreads()) or
+            (_pendingChunks.front()._data.wait_for(chrono::seconds(0)) == future_status::ready))) {
+        writePendingChunk();
     }
+}
 
-    _dataSpace.selectHyperslab(H5S_SELECT_SET, &_bufSize, &_bufStart);
-    _dataSet.read(_buf, _dataType, _chunkSpace, _dataSpace);
-    _dirty = false;
-    assert(_bufSize > 0 || _size == 0);
+// Write the oldest queued chunk to the file, waiting for it to be compressed
+void Hdf5ExternalArray::writePendingChunk() {
+    Hdf5ChunkCompressor::Buffer data = _pendingChunks.front()._data.get();
+    hsize_t offset = _pendingChunks.front()._index * (_chunkBytes / _dataSize);
+    _pendingChunks.pop_front();
+    lock_guard<mutex> guard(hdf5IoMutex);
+#if H5_VERSION_GE(1, 10, 3)
+    herr_t status = H5Dwrite_chunk(_dataSet.getId(), H5P_DEFAULT, 0, &offset, data.size(), data.data());
+#else
+    herr_t status = H5DOwrite_chunk(_dataSet.getId(), H5P_DEFAULT, 0, &offset, data.size(), data.data());
+#endif
+    if (status < 0) {
+        throw hal_exception("error writing chunk of hdf5 array " + _path);
+    }
+}
+
+/* Write queued chunks, in order, until none overlap elements start to end */
+void Hdf5ExternalArray::writePendingChunks(hsize_t start, hsize_t end) {
+    if (_pendingChunks.empty() or (start >= end)) {
+        return;
+    }
+    hsize_t chunkSize = _chunkBytes / _dataSize;
+    size_t numToWrite = 0;
+    for (size_t i = 0; i < _pendingChunks.size(); ++i) {
+        hsize_t chunkStart = _pendingChunks[i]._index * chunkSize;
+        if ((chunkStart < end) and (start < chunkStart + chunkSize)) {
+            numToWrite = i + 1;
+        }
+    }
+    for (size_t i = 0; i < numToWrite; ++i) {
+        writePendingChunk();
+    }
+}
+
+// Page window containing index i into memory, writing it first if modified
+void Hdf5ExternalArray::page(Hdf5ArrayWindow &window, hsize_t i) {
+    if (window.getDirty()) {
+        write(window.getStart(), window.getEnd() - window.getStart(), window.getBuf());
+        window.setDirty(false);
+    }
+    if (window.getEnd() > window.getStart()) {
+        ++_windowEvictions;
+    }
+    ++_windowLoads;
+    hsize_t windowSize = window.getCapacity();
+    hsize_t start = (i / windowSize) * windowSize;
+    hsize_t end = min(start + windowSize, _size);
+    read(start, end - start, window.setRange(start, end));
+}
+
+/* Get the calling thread's window on the array.  Windows are kept per
+ * thread by array id, so the window of a deleted array is only freed when
+ * the thread exits. */
+Hdf5ArrayWindow &Hdf5ExternalArray::getThreadWindow() {
+    static thread_local unordered_map<uint64_t, Hdf5ArrayWindow> threadWindows;
+    static thread_local uint64_t lastId = 0;
+    static thread_local Hdf5ArrayWindow *lastWindow = NULL;
+    if (lastId != _id) {
+        lastWindow = &threadWindows[_id];
+        lastId = _id;
+        if (lastWindow->getCapacity() == 0) {
+            lastWindow->reset(_window.getCapacity(), _dataSize);
+        }
+    }
+    return *lastWindow;
 }
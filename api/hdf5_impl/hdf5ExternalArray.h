@@ -9,8 +9,14 @@
 #define _HDF5EXTERNALARRAY_H
 
 #include "halDefs.h"
+#include "hdf5ChunkCompressor.h"
 #include <H5Cpp.h>
+#include <atomic>
 #include <cassert>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <vector>
 
 // Hack to compile with various versions of HDF5 that aren't themselves compatible
 namespace H5 {
@@ -27,10 +33,107 @@ namespace H5 {
 
 namespace hal {
 
+    /* bytes read at a time from an array that isn't chunked */
+    static const hsize_t HDF5_CONTIGUOUS_WINDOW_BYTES = 256 * 1024;
+
+    /**
+     * Counts of reads and writes made through arrays.  A window is evicted
+     * when it is paged out to make room for another range, so many
+     * evictions per load mean the array is being thrashed.
+     */
+    struct Hdf5ArrayStats {
+        uint64_t _windowLoads;
+        uint64_t _windowEvictions;
+        uint64_t _bytesRead;
+        uint64_t _bytesWritten;
+
+        Hdf5ArrayStats() : _windowLoads(0), _windowEvictions(0), _bytesRead(0), _bytesWritten(0) {
+        }
+        Hdf5ArrayStats &operator+=(const Hdf5ArrayStats &other) {
+            _windowLoads += other._windowLoads;
+            _windowEvictions += other._windowEvictions;
+            _bytesRead += other._bytesRead;
+            _bytesWritten += other._bytesWritten;
+            return *this;
+        }
+    };
+
+    /**
+     * Range of consecutive elements of an array held in memory.  The
+     * maximum number of elements is set independently of how the dataset
+     * is stored, and memory is only allocated when a range is loaded.
+     * Ranges are open-ended.
+     */
+    class Hdf5ArrayWindow {
+      public:
+        Hdf5ArrayWindow() : _capacity(0), _dataSize(0), _start(0), _end(0), _dirty(false) {
+        }
+
+        /** Set the maximum number of elements and the element size,
+         * emptying the window */
+        void reset(hsize_t capacity, hsize_t dataSize) {
+            _capacity = capacity;
+            _dataSize = dataSize;
+            _start = _end = 0;
+            _dirty = false;
+            std::vector<char>().swap(_buf);
+        }
+
+        /** Set the range of elements held, returning the buffer to load
+         * them into */
+        char *setRange(hsize_t start, hsize_t end) {
+            assert((start <= end) && (end - start <= _capacity));
+            _start = start;
+            _end = end;
+            _buf.resize((end - start) * _dataSize);
+            return _buf.data();
+        }
+
+        bool contains(hsize_t i) const {
+            return (i >= _start) && (i < _end);
+        }
+
+        char *getElement(hsize_t i) {
+            assert(contains(i));
+            return _buf.data() + (i - _start) * _dataSize;
+        }
+
+        hsize_t getCapacity() const {
+            return _capacity;
+        }
+        hsize_t getStart() const {
+            return _start;
+        }
+        hsize_t getEnd() const {
+            return _end;
+        }
+        const char *getBuf() const {
+            return _buf.data();
+        }
+
+        /** has an element been modified since the range was loaded? */
+        bool getDirty() const {
+            return _dirty;
+        }
+        void setDirty(bool dirty) {
+            _dirty = dirty;
+        }
+
+      private:
+        hsize_t _capacity;
+        hsize_t _dataSize;
+        hsize_t _start;
+        hsize_t _end;
+        std::vector<char> _buf;
+        bool _dirty;
+    };
+
     /**
      * Wrapper for a 1-dimensional HDF5 array of fixed length.  Array objects
      * are defined (and typed) by the input datatype.  The array is paged into
-     * memory chunk-by-chunk as needed (using the HDF5 cache as a back-end).
+     * memory a window at a time as needed (using the HDF5 cache as a
+     * back-end), reading only the window's elements whether or not the
+     * dataset is chunked.
      * We can't use compiler tpying of the input objects (and instead just
      * expose the raw void* data) because the elements' sizes are not known
      * at compile time, and we don't want to move it around once its read.
@@ -53,9 +156,12 @@ namespace hal {
           * 0: load entire array into buffer
           * 1: use default chunking (from dataset)
           * N: buffersize will be N chunks.
+          * @param compressor Threads to compress whole chunks of a deflated
+          * dataset on, or NULL to let HDF5 compress them when written.
           */
         void create(H5::PortableH5Location *file, const H5std_string &path, const H5::DataType &dataType, hsize_t numElements,
-                    const H5::DSetCreatPropList *inCparms = NULL, hsize_t chunksInBuffer = 1);
+                    const H5::DSetCreatPropList *inCparms = NULL, hsize_t chunksInBuffer = 1,
+                    Hdf5ChunkCompressor *compressor = NULL);
 
         /** Load an existing dataset into memory
           * @param file Pointer to the HDF5 file in which to create array
@@ -64,12 +170,31 @@ namespace hal {
           * 0: load entire array into buffer
           * 1: use default chunking (from dataset)
           * N: buffersize will be N chunks.
+          * @param compressor as for create()
           */
-        void load(H5::PortableH5Location *file, const H5std_string &path, hsize_t chunksInBuffer = 1);
+        void load(H5::PortableH5Location *file, const H5std_string &path, hsize_t chunksInBuffer = 1,
+                  Hdf5ChunkCompressor *compressor = NULL);
 
-        /** Write the memory buffer back to the file */
+        /** Write the memory buffer back to the file, and any chunks still
+         * being compressed */
         void write();
 
+        /** Read elements directly from the file, bypassing the memory buffer
+         * (which is written first if it holds modified elements in the range)
+         * @param start index of first element to read
+         * @param count number of elements to read
+         * @param buf destination of the elements */
+        void read(hsize_t start, hsize_t count, char *buf);
+
+        /** Write elements directly to the file, bypassing the memory buffer.
+         * With a compressor, whole chunks are queued to be compressed and
+         * written later, in order; other elements are written at once.
+         * Elements also held in the memory buffer are updated there.
+         * @param start index of first element to write
+         * @param count number of elements to write
+         * @param buf source of the elements */
+        void write(hsize_t start, hsize_t count, const char *buf);
+
         /** Access the raw data at given index
          * @param i index of element to retrieve for reading
          */
@@ -91,48 +216,56 @@ namespace hal {
          * @param value New value to set */
         template <typename T> void setValue(hsize_t index, hsize_t offset, T value);
 
-        /** Write typed element in the the raw data index
-         * @param offset OFfset of element in struct (number of bytes) */
-
         /** Number of elements in array */
         hsize_t getSize() const {
             return _size;
         }
 
-        /** Get the HDF5 Datatype */
-        const H5::DataType &getDataType() const {
-            return _dataType;
+        /** Number of elements paged into memory at a time */
+        hsize_t getWindowSize() const {
+            return _window.getCapacity();
         }
 
-        /** get the current buffered start */
-        hsize_t getBufStart() const {
-            return _bufStart;
-        }
-        /** Get index of last element in memory buffer (close-ended) */
-        hsize_t getBufEnd() const {
-            return _bufEnd;
+        /** Size in bytes of a chunk of the dataset, or 0 if it isn't chunked */
+        hsize_t getChunkBytes() const {
+            return _chunkBytes;
         }
 
-        /** get in-memory buffer */
-        char *getBuf() {
-            return _buf;
-        }
+        /** Reopen the dataset with its own HDF5 chunk cache, big enough for
+         * numChunks chunks (or all of the array if smaller).
+         * @param w0 preemption policy, as in H5Pset_chunk_cache()
+         * @return size of the chunk cache in bytes */
+        hsize_t setChunkCache(hsize_t numChunks, double w0);
 
-        /* is the buffer dirty? */
-        bool getDirty() const {
-            return _dirty;
-        }
+        /** Get reads and writes made through the array since it was loaded */
+        Hdf5ArrayStats getStats() const;
 
-        /*  dirty if buffer has been modified directly */
-        void setDirty() {
-            _dirty = true;
+        /** Give each thread its own window, so that several threads can
+         * read the array at once.  Writing isn't supported when set. */
+        void setConcurrent(bool concurrent) {
+            _concurrent = concurrent;
         }
 
-        /** Read chunk from file */
-        void page(hsize_t i);
+        /** Get the HDF5 Datatype */
+        const H5::DataType &getDataType() const {
+            return _dataType;
+        }
 
       private:
-        void initBuf();
+        /* chunk queued to be compressed */
+        struct PendingChunk {
+            hsize_t _index;
+            std::future<Hdf5ChunkCompressor::Buffer> _data;
+        };
+
+        void initWindow(const H5::DSetCreatPropList &cparms, hsize_t chunksInBuffer);
+        void initCompressor(const H5::DSetCreatPropList &cparms, Hdf5ChunkCompressor *compressor);
+        void page(Hdf5ArrayWindow &window, hsize_t i);
+        Hdf5ArrayWindow &getThreadWindow();
+        void writeRange(hsize_t start, hsize_t count, const char *buf);
+        void queueChunk(hsize_t chunkIndex, const char *buf, hsize_t count);
+        void writePendingChunk();
+        void writePendingChunks(hsize_t start, hsize_t end);
 
         /** Pointer to file that owns this dataset */
         H5::PortableH5Location *_file;
@@ -140,59 +273,57 @@ namespace hal {
         H5std_string _path;
         /** Datatype for array */
         H5::DataType _dataType;
-        /** Dataspace (dimension information) of array */
-        H5::DataSpace _dataSpace;
         /** The HDF5 array object */
         H5::DataSet _dataSet;
         /** Number of elements in the array (fixed length)*/
         hsize_t _size;
-        /** Size of chunk in elements */
-        hsize_t _chunkSize;
         /** Size of datatype in bytes */
         hsize_t _dataSize;
-        /** Index of first element in memory buffer */
-        hsize_t _bufStart;
-        /** Index of last element in memory buffer */
-        hsize_t _bufEnd; // DANGER: close-ended
-        /** Number of elements in memory buffer */
-        hsize_t _bufSize;
-        /** In-memory buffer */
-        char *_buf;
-        /** Dimensional information for in-memory buffer */
-        H5::DataSpace _chunkSpace;
-        /** Flag saying we should write to disk on write
-         * or page-out calls (set by getUpdate()) */
-        bool _dirty;
+        /** Size of a chunk in bytes, 0 if not chunked */
+        hsize_t _chunkBytes;
+        /** Elements currently in memory, written to disk on write or page-out
+         * calls if marked dirty by getUpdate() */
+        Hdf5ArrayWindow _window;
+        /** Unique id of the array, used to find a thread's own window */
+        uint64_t _id;
+        /** Use a window per thread rather than _window */
+        bool _concurrent;
+        /** Threads compressing chunks for direct writes, NULL if not used */
+        Hdf5ChunkCompressor *_compressor;
+        /** zlib level of the dataset's deflate filter */
+        int _deflateLevel;
+        /** Chunks being compressed, in the order to write them */
+        std::deque<PendingChunk> _pendingChunks;
+        /** Counters for getStats(), updated from any thread */
+        mutable std::atomic<uint64_t> _windowLoads;
+        mutable std::atomic<uint64_t> _windowEvictions;
+        mutable std::atomic<uint64_t> _bytesRead;
+        mutable std::atomic<uint64_t> _bytesWritten;
 
       private:
         Hdf5ExternalArray(const Hdf5ExternalArray &);
         Hdf5ExternalArray &operator=(const Hdf5ExternalArray &);
     };
 
-    /**
-     * Class used to access an Hdf5ExternalArray.  This provides a buffer and
-     * there can be multiple instances active at once.  However, multiple writers
-     * of the same array at the same time will lead to data corruption. */
-
     inline const char *Hdf5ExternalArray::get(hsize_t i) {
         assert(i < _size);
-        if (i < _bufStart || i > _bufEnd) {
-            page(i);
+        Hdf5ArrayWindow &window = _concurrent ? getThreadWindow() : _window;
+        if (not window.contains(i)) {
+            page(window, i);
         }
-        assert((i - _bufStart) < _bufSize);
-        return _buf + (i - _bufStart) * _dataSize;
+        return window.getElement(i);
     }
 
     inline char *Hdf5ExternalArray::getUpdate(hsize_t i) {
         if (i >= _size) {
             throw hal_exception("error: attempt to write hdf5 array out of bounds");
         }
-        if (i < _bufStart || i > _bufEnd) {
-            page(i);
+        assert(not _concurrent);
+        if (not _window.contains(i)) {
+            page(_window, i);
         }
-        _dirty = true;
-        assert((i - _bufStart) < _bufSize);
-        return _buf + (i - _bufStart) * _dataSize;
+        _window.setDirty(true);
+        return _window.getElement(i);
     }
 
     template <typename T> inline T Hdf5ExternalArray::getValue(hsize_t index, hsize_t offset) const {
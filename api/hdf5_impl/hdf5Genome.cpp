@@ -34,12 +34,12 @@ const string Hdf5Genome::sequenceNameArrayName = "SEQNAME_ARRAY";
 const string Hdf5Genome::metaGroupName = "Meta";
 const string Hdf5Genome::rupGroupName = "Rup";
 const double Hdf5Genome::dnaChunkScale = 10.;
-const hal_size_t Hdf5Genome::maxPosCache = 1000;
     
 Hdf5Genome::Hdf5Genome(const string &name, Hdf5Alignment *alignment, PortableH5Location *h5Parent,
                        const DSetCreatPropList &dcProps, bool inMemory)
-    : Genome(alignment, name), _alignment(alignment), _h5Parent(h5Parent), _name(name), _numChildrenInBottomArray(0),
-      _totalSequenceLength(0), _numChunksInArrayBuffer(inMemory ? 0 : 1) {
+    : Genome(alignment, name), _alignment(alignment), _h5Parent(h5Parent), _name(name), _dnaPages(&_dnaArray),
+      _numChildrenInBottomArray(0),
+      _totalSequenceLength(0), _numChunksInArrayBuffer(inMemory ? 0 : 1), _chunkCacheBytes(0) {
     _dcprops.copy(dcProps);
     assert(!name.empty());
     assert(alignment != NULL && h5Parent != NULL);
@@ -130,15 +130,16 @@ void Hdf5Genome::setDimensions(const vector<Sequence::Info> &sequenceDimensions,
         DSetCreatPropList dnaDC;
         dnaDC.copy(_dcprops);
         dnaDC.setChunk(1, &chunk);
-        _dnaArray.create(&_group, dnaArrayName, dnaDataType(), arrayLength, &dnaDC, _numChunksInArrayBuffer);
-        _dnaAccess = DnaAccessPtr(new HDF5DnaAccess(this, &_dnaArray, 0));
+        _dnaArray.create(&_group, dnaArrayName, dnaDataType(), arrayLength, &dnaDC,
+                         _numChunksInArrayBuffer, _alignment->getChunkCompressor());
+        _dnaPages.clear();
     }
     if (totalSeq > 0) {
         _sequenceIdxArray.create(&_group, sequenceIdxArrayName, Hdf5Sequence::idxDataType(), totalSeq + 1, &_dcprops,
-                                 _numChunksInArrayBuffer);
+                                 _numChunksInArrayBuffer, _alignment->getChunkCompressor());
 
         _sequenceNameArray.create(&_group, sequenceNameArrayName, Hdf5Sequence::nameDataType(maxName + 1), totalSeq, &_dcprops,
-                                  _numChunksInArrayBuffer);
+                                  _numChunksInArrayBuffer, _alignment->getChunkCompressor());
 
         writeSequences(sequenceDimensions);
     }
@@ -154,7 +155,7 @@ void Hdf5Genome::updateTopDimensions(const vector<Sequence::UpdateInfo> &topDime
     loadSequencePosCache();
     loadSequenceNameCache();
     vector<Sequence::UpdateInfo>::const_iterator i;
-    map<string, Hdf5Sequence *>::iterator cacheIt;
+    unordered_map<string, Hdf5Sequence *>::iterator cacheIt;
     map<string, const Sequence::UpdateInfo *> inputMap;
     map<string, hal_size_t> currentTopD;
     // copy input into map, checking everything is already present
@@ -172,10 +173,10 @@ void Hdf5Genome::updateTopDimensions(const vector<Sequence::UpdateInfo> &topDime
     // segment (these can get muddled as we add the new ones in the next
     // loop to be sure by getting them in one shot)
     // Note to self: iterating the map in this way skips zero-length
-    // sequences (which are in the separate vector).  This is fine
+    // sequences (which are only in _sequenceCache).  This is fine
     // here since we will never update them, but seems like it could be
     // dangerous if something were to change
-    map<hal_size_t, Hdf5Sequence *>::iterator posCacheIt;
+    vector<pair<hal_size_t, Hdf5Sequence *>>::iterator posCacheIt;
     map<string, const Sequence::UpdateInfo *>::iterator inputIt;
     for (posCacheIt = _sequencePosCache.begin(); posCacheIt != _sequencePosCache.end(); ++posCacheIt) {
         Hdf5Sequence *sequence = posCacheIt->second;
@@ -187,7 +188,7 @@ void Hdf5Genome::updateTopDimensions(const vector<Sequence::UpdateInfo> &topDime
     // scan through existing sequences, updating as necessary
     // build summary of all new and unchanged dimensions in newDimensions
     // Note to self: iterating the map in this way skips zero-length
-    // sequences (which are in the separate vector).  This is fine
+    // sequences (which are only in _sequenceCache).  This is fine
     // here since we will never update them, but seems like it could be
     // dangerous if something were to change
     map<string, hal_size_t>::iterator currentIt;
@@ -204,7 +205,7 @@ void Hdf5Genome::updateTopDimensions(const vector<Sequence::UpdateInfo> &topDime
         } else {
             currentIt = currentTopD.find(sequence->getName());
             assert(currentIt != currentTopD.end());
-            newInfo._name = posCacheIt->first;
+            newInfo._name = sequence->getName();
             newInfo._numSegments = currentIt->second;
             newDimensions.push_back(newInfo);
         }
@@ -218,7 +219,7 @@ void Hdf5Genome::updateBottomDimensions(const vector<Sequence::UpdateInfo> &bott
     loadSequencePosCache();
     loadSequenceNameCache();
     vector<Sequence::UpdateInfo>::const_iterator i;
-    map<string, Hdf5Sequence *>::iterator cacheIt;
+    unordered_map<string, Hdf5Sequence *>::iterator cacheIt;
     map<string, const Sequence::UpdateInfo *> inputMap;
     map<string, hal_size_t> currentBottomD;
     // copy input into map, checking everything is already present
@@ -236,10 +237,10 @@ void Hdf5Genome::updateBottomDimensions(const vector<Sequence::UpdateInfo> &bott
     // segment (these can get muddled as we add the new ones in the next
     // loop to be sure by getting them in one shot)
     // Note to self: iterating the map in this way skips zero-length
-    // sequences (which are in the separate vector).  This is fine
+    // sequences (which are only in _sequenceCache).  This is fine
     // here since we will never update them, but seems like it could be
     // dangerous if something were to change
-    map<hal_size_t, Hdf5Sequence *>::iterator posCacheIt;
+    vector<pair<hal_size_t, Hdf5Sequence *>>::iterator posCacheIt;
     map<string, const Sequence::UpdateInfo *>::iterator inputIt;
     for (posCacheIt = _sequencePosCache.begin(); posCacheIt != _sequencePosCache.end(); ++posCacheIt) {
         Hdf5Sequence *sequence = posCacheIt->second;
@@ -251,7 +252,7 @@ void Hdf5Genome::updateBottomDimensions(const vector<Sequence::UpdateInfo> &bott
     // scan through existing sequences, updating as necessary
     // build summary of all new and unchanged dimensions in newDimensions
     // Note to self: iterating the map in this way skips zero-length
-    // sequences (which are in the separate vector).  This is fine
+    // sequences (which are only in _sequenceCache).  This is fine
     // here since we will never update them, but seems like it could be
     // dangerous if something were to change
     map<string, hal_size_t>::iterator currentIt;
@@ -268,7 +269,7 @@ void Hdf5Genome::updateBottomDimensions(const vector<Sequence::UpdateInfo> &bott
         } else {
             currentIt = currentBottomD.find(sequence->getName());
             assert(currentIt != currentBottomD.end());
-            newInfo._name = posCacheIt->first;
+            newInfo._name = sequence->getName();
             newInfo._numSegments = currentIt->second;
             newDimensions.push_back(newInfo);
         }
@@ -289,7 +290,8 @@ void Hdf5Genome::setGenomeTopDimensions(const vector<Sequence::UpdateInfo> &topD
         _group.unlink(topArrayName);
     } catch (H5::Exception &) {
     }
-    _topArray.create(&_group, topArrayName, Hdf5TopSegment::dataType(), numTopSegments + 1, &_dcprops, _numChunksInArrayBuffer);
+    _topArray.create(&_group, topArrayName, Hdf5TopSegment::dataType(), numTopSegments + 1, &_dcprops,
+                     _numChunksInArrayBuffer, _alignment->getChunkCompressor());
     reload();
 }
 
@@ -317,7 +319,8 @@ void Hdf5Genome::setGenomeBottomDimensions(const vector<Sequence::UpdateInfo> &b
     botDC.setChunk(1, &chunk);
 
     _bottomArray.create(&_group, bottomArrayName, Hdf5BottomSegment::dataType(numChildren), numBottomSegments + 1, &botDC,
-                        _numChunksInArrayBuffer);
+                        _numChunksInArrayBuffer, _alignment->getChunkCompressor());
+    _numChildrenInBottomArray = numChildren;
     reload();
 }
 
@@ -327,9 +330,10 @@ hal_size_t Hdf5Genome::getNumSequences() const {
 }
 
 Sequence *Hdf5Genome::getSequence(const string &name) {
+    lock_guard<mutex> guard(_sequenceCacheMutex);
     loadSequenceNameCache();
     Sequence *sequence = NULL;
-    map<string, Hdf5Sequence *>::iterator mapIt = _sequenceNameCache.find(name);
+    unordered_map<string, Hdf5Sequence *>::iterator mapIt = _sequenceNameCache.find(name);
     if (mapIt != _sequenceNameCache.end()) {
         sequence = mapIt->second;
     }
@@ -341,56 +345,17 @@ const Sequence *Hdf5Genome::getSequence(const string &name) const {
 }
 
 Sequence *Hdf5Genome::getSequenceBySite(hal_size_t position) {
-    hal_size_t numSequences = _sequenceNameArray.getSize();
-    if (numSequences <= maxPosCache) {
-        loadSequencePosCache();
-    }
-    
-    // check the cache
-    map<hal_size_t, Hdf5Sequence *>::iterator i;
-    i = _sequencePosCache.upper_bound(position);
-    if (i != _sequencePosCache.end()) {
-        if (position >= (hal_size_t)i->second->getStartPosition() && position <= (hal_size_t)i->second->getEndPosition()) {
-            return i->second;
-        }
-    }
-    
-    // it wasn't in the pos cache.  we dig it out of the array using binary search
-    hal_index_t low_idx = 0;
-    hal_index_t high_idx = (hal_index_t)numSequences - 1;
-    
-    while (low_idx <= high_idx) {
-        hal_index_t mid_idx = (low_idx + high_idx) / 2;
-        Hdf5Sequence *seq =
-            new Hdf5Sequence(const_cast<Hdf5Genome *>(this), const_cast<Hdf5ExternalArray *>(&_sequenceIdxArray),
-                             const_cast<Hdf5ExternalArray *>(&_sequenceNameArray), mid_idx);
-        if (position >= seq->getStartPosition() && position <= seq->getEndPosition()) {
-            _sequencePosCache[seq->getStartPosition() + seq->getSequenceLength()] = seq;
-            return seq;
-        } else {
-            bool less = position < seq->getStartPosition();
-            delete seq;
-            if (less) {
-                high_idx = mid_idx - 1;
-            } else {
-                low_idx = mid_idx + 1;
-            }
-        }
-    }
-
-    // something went wrong (sequences stored out of order?!), fall back on the cache
-    if (numSequences > maxPosCache) {
-        cerr << "Binary search failed on " << getName() << ":" << position << " reverting to full cache" << endl;
-        loadSequencePosCache();
-        i = _sequencePosCache.upper_bound(position);
-        if (i != _sequencePosCache.end()) {
-            if (position >= (hal_size_t)i->second->getStartPosition() && position <= (hal_size_t)i->second->getEndPosition()) {
-                return i->second;
-            }
-        }
+    lock_guard<mutex> guard(_sequenceCacheMutex);
+    loadSequencePosCache();
+    // the sequences of non-zero length tile the genome, so the first one
+    // ending after the position contains it
+    vector<pair<hal_size_t, Hdf5Sequence *>>::const_iterator i =
+        upper_bound(_sequencePosCache.begin(), _sequencePosCache.end(), position,
+                    [](hal_size_t pos, const pair<hal_size_t, Hdf5Sequence *> &seqEnd) { return pos < seqEnd.first; });
+    if (i == _sequencePosCache.end()) {
+        throw hal_exception("Position cache fail on " + getName() + ":" + std::to_string(position));
     }
-    throw hal_exception("Position cache fail on " + getName() + ":" + std::to_string(position));
-    return NULL;
+    return i->second;
 }
 
 const Sequence *Hdf5Genome::getSequenceBySite(hal_size_t position) const {
@@ -487,7 +452,8 @@ BottomSegmentIteratorPtr Hdf5Genome::getBottomSegmentIterator(hal_index_t positi
 
 DnaIteratorPtr Hdf5Genome::getDnaIterator(hal_index_t position) {
     assert(position / 2 <= (hal_index_t)_dnaArray.getSize());
-    DnaIterator *dnaIt = new DnaIterator(this, _dnaAccess, position);
+    // each iterator gets its own access, so iterators at distant positions don't share a page
+    DnaIterator *dnaIt = new DnaIterator(this, DnaAccessPtr(new HDF5DnaAccess(&_dnaPages)), position);
     return DnaIteratorPtr(dnaIt);
 }
 
@@ -568,25 +534,24 @@ void Hdf5Genome::write() {
 }
 
 void Hdf5Genome::read() {
-    bool dnaLoaded = false;
+    _dnaPages.clear();
     try {
         HDF5DisableExceptionPrinting prDisable;
         _group.openDataSet(dnaArrayName);
-        _dnaArray.load(&_group, dnaArrayName, _numChunksInArrayBuffer);
-        dnaLoaded = true;
+        _dnaArray.load(&_group, dnaArrayName, _numChunksInArrayBuffer, _alignment->getChunkCompressor());
     } catch (H5::Exception &) {
     }
 
     try {
         HDF5DisableExceptionPrinting prDisable;
         _group.openDataSet(topArrayName);
-        _topArray.load(&_group, topArrayName, _numChunksInArrayBuffer);
+        _topArray.load(&_group, topArrayName, _numChunksInArrayBuffer, _alignment->getChunkCompressor());
     } catch (H5::Exception &) {
     }
     try {
         HDF5DisableExceptionPrinting prDisable;
         _group.openDataSet(bottomArrayName);
-        _bottomArray.load(&_group, bottomArrayName, _numChunksInArrayBuffer);
+        _bottomArray.load(&_group, bottomArrayName, _numChunksInArrayBuffer, _alignment->getChunkCompressor());
         _numChildrenInBottomArray = Hdf5BottomSegment::numChildrenFromDataType(_bottomArray.getDataType());
     } catch (H5::Exception &) {
     }
@@ -595,20 +560,17 @@ void Hdf5Genome::read() {
     try {
         HDF5DisableExceptionPrinting prDisable;
         _group.openDataSet(sequenceIdxArrayName);
-        _sequenceIdxArray.load(&_group, sequenceIdxArrayName, _numChunksInArrayBuffer);
+        _sequenceIdxArray.load(&_group, sequenceIdxArrayName, _numChunksInArrayBuffer, _alignment->getChunkCompressor());
     } catch (H5::Exception &) {
     }
     try {
         HDF5DisableExceptionPrinting prDisable;
         _group.openDataSet(sequenceNameArrayName);
-        _sequenceNameArray.load(&_group, sequenceNameArrayName, _numChunksInArrayBuffer);
+        _sequenceNameArray.load(&_group, sequenceNameArrayName, _numChunksInArrayBuffer, _alignment->getChunkCompressor());
     } catch (H5::Exception &) {
     }
 
     readSequences();
-    if (dnaLoaded) {
-        _dnaAccess = DnaAccessPtr(new HDF5DnaAccess(this, &_dnaArray, 0));
-    }
 }
 
 void Hdf5Genome::readSequences() {
@@ -616,59 +578,46 @@ void Hdf5Genome::readSequences() {
 }
 
 void Hdf5Genome::deleteSequenceCache() {
-    if (_sequencePosCache.size() > 0 || _zeroLenPosCache.size() > 0) {
-        map<hal_size_t, Hdf5Sequence *>::iterator i;
-        for (i = _sequencePosCache.begin(); i != _sequencePosCache.end(); ++i) {
-            delete i->second;
-        }
-        vector<Hdf5Sequence *>::iterator z;
-        for (z = _zeroLenPosCache.begin(); z != _zeroLenPosCache.end(); ++z) {
-            delete *z;
-        }
-    } else if (_sequenceNameCache.size() > 0) {
-        map<string, Hdf5Sequence *>::iterator i;
-        for (i = _sequenceNameCache.begin(); i != _sequenceNameCache.end(); ++i) {
-            delete i->second;
-        }
+    for (Hdf5Sequence *sequence : _sequenceCache) {
+        delete sequence;
     }
+    _sequenceCache.clear();
     _sequencePosCache.clear();
-    _zeroLenPosCache.clear();
-    _sequenceNameCache.clear(); // I share my pointers with above.
+    _sequenceNameCache.clear();
+}
+
+/* make a sequence object for every sequence, which the position and name
+ * caches share */
+void Hdf5Genome::loadSequenceCache() const {
+    hal_size_t numSequences = _sequenceNameArray.getSize();
+    if (_sequenceCache.size() == numSequences) {
+        return;
+    }
+    assert(_sequenceCache.empty());
+    _sequenceCache.reserve(numSequences);
+    for (hal_size_t i = 0; i < numSequences; ++i) {
+        _sequenceCache.push_back(new Hdf5Sequence(const_cast<Hdf5Genome *>(this),
+                                                  const_cast<Hdf5ExternalArray *>(&_sequenceIdxArray),
+                                                  const_cast<Hdf5ExternalArray *>(&_sequenceNameArray), i));
+    }
 }
 
 void Hdf5Genome::loadSequencePosCache() const {
-    if (_sequencePosCache.size() > 0 || _zeroLenPosCache.size() > 0) {
+    if (_sequencePosCache.size() > 0) {
         return;
     }
+    loadSequenceCache();
     hal_size_t totalReadLen = 0;
-    hal_size_t numSequences = _sequenceNameArray.getSize();
-
-    if (_sequenceNameCache.size() > 0) {
-        assert(_sequenceNameCache.size() == numSequences);
-        map<std::string, Hdf5Sequence *>::const_iterator i;
-        for (i = _sequenceNameCache.begin(); i != _sequenceNameCache.end(); ++i) {
-            if (i->second->getSequenceLength() > 0) {
-                _sequencePosCache.insert(pair<hal_size_t, Hdf5Sequence *>(
-                    i->second->getStartPosition() + i->second->getSequenceLength(), i->second));
-                totalReadLen += i->second->getSequenceLength();
-            } else {
-                // FIXME: _zeroLenPosCache.push_back(i->second);
-            }
-        }
-    } else {
-        for (hal_size_t i = 0; i < numSequences; ++i) {
-            Hdf5Sequence *seq =
-                new Hdf5Sequence(const_cast<Hdf5Genome *>(this), const_cast<Hdf5ExternalArray *>(&_sequenceIdxArray),
-                                 const_cast<Hdf5ExternalArray *>(&_sequenceNameArray), i);
-            if (seq->getSequenceLength() > 0) {
-                _sequencePosCache.insert(
-                    pair<hal_size_t, Hdf5Sequence *>(seq->getStartPosition() + seq->getSequenceLength(), seq));
-                totalReadLen += seq->getSequenceLength();
-            } else {
-                // FIXME: _zeroLenPosCache.push_back(seq);
-            }
+    for (Hdf5Sequence *seq : _sequenceCache) {
+        if (seq->getSequenceLength() > 0) {
+            _sequencePosCache.push_back(
+                pair<hal_size_t, Hdf5Sequence *>(seq->getStartPosition() + seq->getSequenceLength(), seq));
+            totalReadLen += seq->getSequenceLength();
         }
     }
+    if (not is_sorted(_sequencePosCache.begin(), _sequencePosCache.end())) {
+        sort(_sequencePosCache.begin(), _sequencePosCache.end());
+    }
     if (_totalSequenceLength > 0 && totalReadLen != _totalSequenceLength) {
         throw hal_exception("Sequences for genome " + getName() + " have total length " + std::to_string(totalReadLen) +
                             " but the (non-zero) DNA array contains " + std::to_string(_totalSequenceLength) +
@@ -680,31 +629,11 @@ void Hdf5Genome::loadSequenceNameCache() const {
     if (_sequenceNameCache.size() > 0) {
         return;
     }
-    hal_size_t numSequences = _sequenceNameArray.getSize();
-
-    // load what we can from the pos cache (which can be partial)
-    map<hal_size_t, Hdf5Sequence *>::iterator i;
-    for (i = _sequencePosCache.begin(); i != _sequencePosCache.end(); ++i) {
-        _sequenceNameCache.insert(pair<string, Hdf5Sequence *>(i->second->getName(), i->second));
-    }
-    vector<Hdf5Sequence *>::iterator z;
-    for (z = _zeroLenPosCache.begin(); z != _zeroLenPosCache.end(); ++z) {
-        _sequenceNameCache.insert(pair<string, Hdf5Sequence *>((*z)->getName(), (*z)));
-    }
-    // load everything else
-    if (_sequenceNameCache.size() < numSequences) {        
-        for (hal_size_t i = 0; i < numSequences; ++i) {
-            Hdf5Sequence *seq =
-                new Hdf5Sequence(const_cast<Hdf5Genome *>(this), const_cast<Hdf5ExternalArray *>(&_sequenceIdxArray),
-                                 const_cast<Hdf5ExternalArray *>(&_sequenceNameArray), i);
-            if (!_sequenceNameCache.count(seq->getName())) {
-                _sequenceNameCache.insert(pair<string, Hdf5Sequence *>(seq->getName(), seq));
-            } else {
-                delete seq;
-            }
-        }
+    loadSequenceCache();
+    _sequenceNameCache.reserve(_sequenceCache.size());
+    for (Hdf5Sequence *seq : _sequenceCache) {
+        _sequenceNameCache.insert(pair<string, Hdf5Sequence *>(seq->getName(), seq));
     }
-    assert(_sequenceNameCache.size() == numSequences);
 }
 
 void Hdf5Genome::writeSequences(const vector<Sequence::Info> &sequenceDimensions) {
@@ -719,10 +648,9 @@ void Hdf5Genome::writeSequences(const vector<Sequence::Info> &sequenceDimensions
         // write all the Sequence::Info into the hdf5 sequence record
         seq->set(startPosition, *i, topArrayIndex, bottomArrayIndex);
         // Keep the object pointer in our caches
+        _sequenceCache.push_back(seq);
         if (seq->getSequenceLength() > 0) {
-            _sequencePosCache.insert(pair<hal_size_t, Hdf5Sequence *>(startPosition + i->_length, seq));
-        } else {
-            // FIXME: _zeroLenPosCache.push_back(seq);
+            _sequencePosCache.push_back(pair<hal_size_t, Hdf5Sequence *>(startPosition + i->_length, seq));
         }
         _sequenceNameCache.insert(pair<string, Hdf5Sequence *>(i->_name, seq));
         startPosition += i->_length;
@@ -736,6 +664,49 @@ void Hdf5Genome::resetBranchCaches() {
     _childCache.clear();
 }
 
+/* Prepare for lookups from several threads.  The parent and child caches
+ * are filled, so they are only read from now on, and each thread gets its
+ * own windows on the arrays. */
+void Hdf5Genome::setConcurrentReads() {
+    getParent();
+    for (hal_size_t i = 0; i < getNumChildren(); i++) {
+        getChild(i);
+    }
+    _dnaArray.setConcurrent(true);
+    _topArray.setConcurrent(true);
+    _bottomArray.setConcurrent(true);
+    _sequenceIdxArray.setConcurrent(true);
+    _sequenceNameArray.setConcurrent(true);
+}
+
+/* Share a budget of chunk cache bytes between the arrays, so that each
+ * caches the same number of chunks.  Each array gets at least one chunk,
+ * even if that is over budget. */
+void Hdf5Genome::setChunkCacheBudget(hsize_t budget, double w0) {
+    Hdf5ExternalArray *arrays[] = {&_dnaArray, &_topArray, &_bottomArray, &_sequenceIdxArray, &_sequenceNameArray};
+    hsize_t chunkBytes = 0;
+    for (Hdf5ExternalArray *array : arrays) {
+        chunkBytes += array->getChunkBytes();
+    }
+    _chunkCacheBytes = 0;
+    if (chunkBytes > 0) {
+        hsize_t numChunks = max(budget / chunkBytes, hsize_t(1));
+        for (Hdf5ExternalArray *array : arrays) {
+            _chunkCacheBytes += array->setChunkCache(numChunks, w0);
+        }
+    }
+}
+
+Hdf5ArrayStats Hdf5Genome::getArrayStats() const {
+    Hdf5ArrayStats stats;
+    stats += _dnaArray.getStats();
+    stats += _topArray.getStats();
+    stats += _bottomArray.getStats();
+    stats += _sequenceIdxArray.getStats();
+    stats += _sequenceNameArray.getStats();
+    return stats;
+}
+
 void Hdf5Genome::rename(const string &newName) {
     _group.move("/" + _name, "/" + newName);
     string newickStr = _alignment->getNewickTree();
@@ -746,6 +717,36 @@ void Hdf5Genome::rename(const string &newName) {
     stTree_destruct(tree);
 }
 
+/* Segments are read and written straight through the arrays, several
+ * chunks at a time, rather than an element at a time through windows */
+void Hdf5Genome::getSegmentBlock(bool top, hal_index_t first, hal_size_t count, SegmentBlock &block) const {
+    if ((first < 0) || (first + count > (top ? getNumTopSegments() : getNumBottomSegments()))) {
+        throw hal_exception("segment block out of range in genome " + _name);
+    }
+    if (top) {
+        Hdf5TopSegment::readBlock(const_cast<Hdf5ExternalArray *>(&_topArray), first, count, block);
+    } else {
+        Hdf5BottomSegment::readBlock(const_cast<Hdf5ExternalArray *>(&_bottomArray), _numChildrenInBottomArray, first,
+                                     count, block);
+    }
+}
+
+void Hdf5Genome::setSegmentBlock(bool top, const SegmentBlock &block) {
+    hal_size_t count = block.getNumSegments();
+    if ((block._first < 0) || (block._first + count > (top ? getNumTopSegments() : getNumBottomSegments())) ||
+        (block._startPositions[count] > (hal_index_t)getSequenceLength())) {
+        throw hal_exception("segment block out of range in genome " + _name);
+    }
+    if (top) {
+        Hdf5TopSegment::writeBlock(&_topArray, block);
+    } else {
+        if (block._numChildren != _numChildrenInBottomArray) {
+            throw hal_exception("segment block has wrong number of children for genome " + _name);
+        }
+        Hdf5BottomSegment::writeBlock(&_bottomArray, block);
+    }
+}
+
 void Hdf5Genome::renameSequence(const string &oldName, size_t index, const string &newName) {
     if (oldName.size() < newName.size()) {
         resizeNameArray(newName.size() + 1);
@@ -774,7 +775,7 @@ void Hdf5Genome::resizeNameArray(size_t newMaxSize) {
         }
 
         _sequenceNameArray.create(&_group, sequenceNameArrayName, Hdf5Sequence::nameDataType(newMaxSize), numSequences,
-                                  &_dcprops, _numChunksInArrayBuffer);
+                                  &_dcprops, _numChunksInArrayBuffer, _alignment->getChunkCompressor());
         for (size_t i = 0; i < numSequences; i++) {
             char *arrayBuffer = _sequenceNameArray.getUpdate(i);
             strcpy(arrayBuffer, names[i].c_str());
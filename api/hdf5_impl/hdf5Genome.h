@@ -12,9 +12,12 @@
 #include "halGenome.h"
 #include "halTopSegmentIterator.h"
 #include "hdf5Alignment.h"
+#include "hdf5DnaDriver.h"
 #include "hdf5ExternalArray.h"
 #include "hdf5MetaData.h"
 #include <H5Cpp.h>
+#include <mutex>
+#include <unordered_map>
 
 namespace hal {
 
@@ -75,6 +78,10 @@ namespace hal {
 
         void rename(const std::string &newName);
 
+        void getSegmentBlock(bool top, hal_index_t first, hal_size_t count, SegmentBlock &block) const;
+
+        void setSegmentBlock(bool top, const SegmentBlock &block);
+
         // SEGMENTED SEQUENCE INTERFACE
 
         hal_size_t getSequenceLength() const;
@@ -121,12 +128,19 @@ namespace hal {
         void create();
         void resetTreeCache();
         void resetBranchCaches();
+        void setConcurrentReads();
+        void setChunkCacheBudget(hsize_t budget, double w0);
+        hsize_t getChunkCacheBytes() const {
+            return _chunkCacheBytes;
+        }
+        Hdf5ArrayStats getArrayStats() const;
         void renameSequence(const std::string &oldName, size_t index, const std::string &newName);
 
       private:
         void readSequences();
         void writeSequences(const std::vector<hal::Sequence::Info> &sequenceDimensions);
         void deleteSequenceCache();
+        void loadSequenceCache() const;
         void loadSequencePosCache() const;
         void loadSequenceNameCache() const;
         void setGenomeTopDimensions(const std::vector<hal::Sequence::UpdateInfo> &sequenceDimensions);
@@ -147,19 +161,21 @@ namespace hal {
         Hdf5ExternalArray _sequenceIdxArray;
         Hdf5ExternalArray _sequenceNameArray;
 
-        // FIXME: every DNAIteratorPtr uses the same DNAAccess. This causes
-        // thrashing when multiple DNAIterators are used concurrently
-        // accessing different stretches of DNA.
-        DnaAccessPtr _dnaAccess;
+        HDF5DnaPageCache _dnaPages;
         H5::Group _group;
         H5::DSetCreatPropList _dcprops;
         hal_size_t _numChildrenInBottomArray;
         hal_size_t _totalSequenceLength;
         hal_size_t _numChunksInArrayBuffer;
+        hsize_t _chunkCacheBytes;
 
-        mutable std::map<hal_size_t, Hdf5Sequence *> _sequencePosCache;
-        mutable std::vector<Hdf5Sequence *> _zeroLenPosCache;
-        mutable std::map<std::string, Hdf5Sequence *> _sequenceNameCache;
+        // all sequences, by index.  owns the sequences the other caches point to
+        mutable std::vector<Hdf5Sequence *> _sequenceCache;
+        // end position (exclusive) of each sequence of non-zero length, in
+        // position order, for binary search by site
+        mutable std::vector<std::pair<hal_size_t, Hdf5Sequence *>> _sequencePosCache;
+        mutable std::unordered_map<std::string, Hdf5Sequence *> _sequenceNameCache;
+        mutable std::mutex _sequenceCacheMutex; // protects the sequence caches during lookups
 
         static const std::string dnaArrayName;
         static const std::string topArrayName;
@@ -168,7 +184,6 @@ namespace hal {
         static const std::string sequenceNameArrayName;
         static const std::string metaGroupName;
         static const std::string rupGroupName;
-        static const hal_size_t maxPosCache;
 
         static const double dnaChunkScale;
     };
@@ -9,6 +9,7 @@
 #include "hdf5BottomSegment.h"
 #include "hdf5Genome.h"
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <string>
 
@@ -86,3 +87,40 @@ H5::CompType Hdf5TopSegment::dataType() {
 
     return dataType;
 }
+
+/* Elements are read with the one after the last segment, which holds its
+ * end position.  Fields are copied with memcpy as elements are packed. */
+void Hdf5TopSegment::readBlock(Hdf5ExternalArray *array, hal_index_t first, hal_size_t count, SegmentBlock &block) {
+    block.resize(first, count, true, 1);
+    vector<char> elements((count + 1) * totalSize);
+    array->read(first, count + 1, elements.data());
+    for (hal_size_t i = 0; i < count; ++i) {
+        const char *element = elements.data() + i * totalSize;
+        memcpy(&block._startPositions[i], element + genomeIndexOffset, sizeof(hal_index_t));
+        memcpy(&block._parseIndexes[i], element + bottomIndexOffset, sizeof(hal_index_t));
+        memcpy(&block._paralogyIndexes[i], element + parIndexOffset, sizeof(hal_index_t));
+        memcpy(&block._linkIndexes[i], element + parentIndexOffset, sizeof(hal_index_t));
+        block._reversed[i] = element[parentReversedOffset];
+    }
+    memcpy(&block._startPositions[count], elements.data() + count * totalSize + genomeIndexOffset, sizeof(hal_index_t));
+}
+
+/* The element after the last segment is left to the next block, unless it
+ * is the one at the end of the array that only holds an end position. */
+void Hdf5TopSegment::writeBlock(Hdf5ExternalArray *array, const SegmentBlock &block) {
+    hal_size_t count = block.getNumSegments();
+    hal_size_t numElements = (block._first + count + 1 == array->getSize()) ? count + 1 : count;
+    vector<char> elements(numElements * totalSize, 0);
+    for (hal_size_t i = 0; i < count; ++i) {
+        char *element = elements.data() + i * totalSize;
+        memcpy(element + genomeIndexOffset, &block._startPositions[i], sizeof(hal_index_t));
+        memcpy(element + bottomIndexOffset, &block._parseIndexes[i], sizeof(hal_index_t));
+        memcpy(element + parIndexOffset, &block._paralogyIndexes[i], sizeof(hal_index_t));
+        memcpy(element + parentIndexOffset, &block._linkIndexes[i], sizeof(hal_index_t));
+        element[parentReversedOffset] = block._reversed[i] ? 1 : 0;
+    }
+    if (numElements > count) {
+        memcpy(elements.data() + count * totalSize + genomeIndexOffset, &block._startPositions[count], sizeof(hal_index_t));
+    }
+    array->write(block._first, numElements, elements.data());
+}
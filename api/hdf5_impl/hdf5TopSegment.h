@@ -55,6 +55,12 @@ namespace hal {
         // HDF5 SPECIFIC
         static H5::CompType dataType();
 
+        /* read segments first to first + count - 1 of an array into a block */
+        static void readBlock(Hdf5ExternalArray *array, hal_index_t first, hal_size_t count, SegmentBlock &block);
+
+        /* write the segments of a block to an array */
+        static void writeBlock(Hdf5ExternalArray *array, const SegmentBlock &block);
+
       private:
         Hdf5Genome *getHdf5Genome() const {
             return static_cast<Hdf5Genome *>(_genome);
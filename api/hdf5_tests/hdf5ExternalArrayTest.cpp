@@ -131,10 +131,53 @@ void hdf5ExternalArrayTestCompression(CuTest *testCase) {
     }
 }
 
+/* windows of chunked and contiguous arrays, accessed out of order */
+void hdf5ExternalArrayTestWindows(CuTest *testCase) {
+    static const hsize_t chunksInBuffers[] = {0, 1, 3};
+    for (hsize_t chunkIdx = 0; chunkIdx < numSizes; ++chunkIdx) {
+        hsize_t chunkSize = chunkSizes[chunkIdx];
+        setup();
+        try {
+            writeNumbers(chunkSize);
+            for (hsize_t chunksInBuffer : chunksInBuffers) {
+                H5File file(H5std_string(fileName), H5F_ACC_RDWR);
+                Hdf5ExternalArray myArray;
+                myArray.load(&file, datasetName, chunksInBuffer);
+                if (chunksInBuffer == 0) {
+                    CuAssertTrue(testCase, myArray.getWindowSize() == N);
+                } else if ((chunkSize == 0) || (chunkSize > N)) {
+                    CuAssertTrue(testCase, myArray.getWindowSize() == HDF5_CONTIGUOUS_WINDOW_BYTES / sizeof(int64_t));
+                } else {
+                    CuAssertTrue(testCase, myArray.getWindowSize() == min(chunkSize * chunksInBuffer, N));
+                }
+                // update, then read back, in a stride crossing windows
+                for (hsize_t j = 0; j < N; j += 9973) {
+                    hsize_t i = (j * 7919) % N;
+                    *reinterpret_cast<int64_t *>(myArray.getUpdate(i)) = numbers[i] + 1;
+                }
+                myArray.write();
+                for (hsize_t j = 0; j < N; j += 9973) {
+                    hsize_t i = (j * 7919) % N;
+                    CuAssertTrue(testCase, *reinterpret_cast<const int64_t *>(myArray.get(i)) == numbers[i] + 1);
+                    numbers[i]++;
+                }
+                CuAssertTrue(testCase, *reinterpret_cast<const int64_t *>(myArray.get(N - 1)) == numbers[N - 1]);
+            }
+        } catch (Exception &exception) {
+            cerr << exception.getCDetailMsg() << endl;
+            CuAssertTrue(testCase, 0);
+        } catch (...) {
+            CuAssertTrue(testCase, 0);
+        }
+        teardown();
+    }
+}
+
 CuSuite *hdf5ExternalArrayTestSuite(void) {
     CuSuite *suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, hdf5ExternalArrayTestCreate);
     SUITE_ADD_TEST(suite, hdf5ExternalArrayTestLoad);
     SUITE_ADD_TEST(suite, hdf5ExternalArrayTestCompression);
+    SUITE_ADD_TEST(suite, hdf5ExternalArrayTestWindows);
     return suite;
 }
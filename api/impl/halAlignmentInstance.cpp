@@ -69,8 +69,13 @@ Alignment *hal::hdf5AlignmentInstance(const std::string &alignmentPath, unsigned
     return new Hdf5Alignment(alignmentPath, mode, fileCreateProps, fileAccessProps, datasetCreateProps, inMemory);
 }
 
-Alignment *hal::mmapAlignmentInstance(const std::string &alignmentPath, unsigned mode, size_t fileSize) {
-    return new MMapAlignment(alignmentPath, mode, fileSize);
+Alignment *hal::mmapAlignmentInstance(const std::string &alignmentPath, unsigned mode, size_t fileSize,
+                                      MMapDnaStorage dnaStorage) {
+    return new MMapAlignment(alignmentPath, mode, fileSize, dnaStorage);
+}
+
+void hal::mmapCompactAlignment(const std::string &inPath, const std::string &outPath, size_t fileSize) {
+    MMapAlignment::compact(inPath, outPath, fileSize);
 }
 
 static const int DETECT_INITIAL_NUM_BYTES = 64;
@@ -260,6 +260,61 @@ void hal::Genome::copyMetadata(Genome *dest) const {
     }
 }
 
+void hal::Genome::getSegmentBlock(bool top, hal_index_t first, hal_size_t count, SegmentBlock &block) const {
+    block.resize(first, count, top, top ? 1 : getNumChildren());
+    if (top) {
+        TopSegmentIteratorPtr topIt = getTopSegmentIterator(first);
+        for (hal_size_t i = 0; i < count; ++i, topIt->toRight()) {
+            const TopSegment *tseg = topIt->tseg();
+            block._startPositions[i] = tseg->getStartPosition();
+            block._startPositions[i + 1] = tseg->getStartPosition() + tseg->getLength();
+            block._parseIndexes[i] = tseg->getBottomParseIndex();
+            block._linkIndexes[i] = tseg->getParentIndex();
+            block._paralogyIndexes[i] = tseg->getNextParalogyIndex();
+            block._reversed[i] = tseg->getParentReversed();
+        }
+    } else {
+        BottomSegmentIteratorPtr botIt = getBottomSegmentIterator(first);
+        for (hal_size_t i = 0; i < count; ++i, botIt->toRight()) {
+            const BottomSegment *bseg = botIt->bseg();
+            block._startPositions[i] = bseg->getStartPosition();
+            block._startPositions[i + 1] = bseg->getStartPosition() + bseg->getLength();
+            block._parseIndexes[i] = bseg->getTopParseIndex();
+            for (hal_size_t child = 0; child < block._numChildren; ++child) {
+                block._linkIndexes[i * block._numChildren + child] = bseg->getChildIndex(child);
+                block._reversed[i * block._numChildren + child] = bseg->getChildReversed(child);
+            }
+        }
+    }
+}
+
+void hal::Genome::setSegmentBlock(bool top, const SegmentBlock &block) {
+    hal_size_t count = block.getNumSegments();
+    if (top) {
+        TopSegmentIteratorPtr topIt = getTopSegmentIterator(block._first);
+        for (hal_size_t i = 0; i < count; ++i, topIt->toRight()) {
+            TopSegment *tseg = topIt->tseg();
+            tseg->setCoordinates(block._startPositions[i], block._startPositions[i + 1] - block._startPositions[i]);
+            tseg->setBottomParseIndex(block._parseIndexes[i]);
+            tseg->setParentIndex(block._linkIndexes[i]);
+            tseg->setNextParalogyIndex(block._paralogyIndexes[i]);
+            tseg->setParentReversed(block._reversed[i]);
+        }
+    } else {
+        assert(block._numChildren == getNumChildren());
+        BottomSegmentIteratorPtr botIt = getBottomSegmentIterator(block._first);
+        for (hal_size_t i = 0; i < count; ++i, botIt->toRight()) {
+            BottomSegment *bseg = botIt->bseg();
+            bseg->setCoordinates(block._startPositions[i], block._startPositions[i + 1] - block._startPositions[i]);
+            bseg->setTopParseIndex(block._parseIndexes[i]);
+            for (hal_size_t child = 0; child < block._numChildren; ++child) {
+                bseg->setChildIndex(child, block._linkIndexes[i * block._numChildren + child]);
+                bseg->setChildReversed(child, block._reversed[i * block._numChildren + child]);
+            }
+        }
+    }
+}
+
 void hal::Genome::fixParseInfo() {
     if (getParent() == NULL || getNumChildren() == 0) {
         return;
@@ -237,15 +237,16 @@ void SegmentIterator::toRight(hal_index_t rightCutoff) {
            _startOffset + _endOffset <= getSegment()->getLength());
 }
 
+/* ranges of at most this many segments from a genome's index are scanned
+ * rather than searched */
+static const hal_index_t TO_SITE_SCAN_LIMIT = 8;
+
 void SegmentIterator::toSite(hal_index_t position, bool slice) {
     Genome *genome = getGenome();
     hal_index_t len = (hal_index_t)genome->getSequenceLength();
     hal_index_t nseg = (hal_index_t)getNumSegmentsInGenome();
 
     assert(len != 0);
-    double avgLen = (double)len / (double)nseg;
-    hal_index_t hint = (hal_index_t)min(nseg - 1., avgLen * ((double)position / (double)len));
-    getSegment()->setArrayIndex(genome, hint);
     _startOffset = 0;
     _endOffset = 0;
 
@@ -262,6 +263,27 @@ void SegmentIterator::toSite(hal_index_t position, bool slice) {
     hal_index_t leftStartPosition = 0;
     hal_index_t right = nseg - 1;
     hal_index_t rightStartPosition = len - 1;
+    double avgLen = (double)len / (double)nseg;
+    if (genome->getSegmentIndexRange(isTop(), position, left, right)) {
+        getSegment()->setArrayIndex(genome, left);
+        if (right - left <= TO_SITE_SCAN_LIMIT) {
+            // scan the few segments in the range from the genome's index
+            while (overlaps(position) == false) {
+                assert(getSegment()->getArrayIndex() < right);
+                getSegment()->setArrayIndex(genome, getSegment()->getArrayIndex() + 1);
+            }
+        } else {
+            leftStartPosition = getSegment()->getStartPosition();
+            getSegment()->setArrayIndex(genome, right);
+            rightStartPosition = getSegment()->getStartPosition();
+            avgLen = double(rightStartPosition - leftStartPosition + 1) / (right - left + 1);
+            hal_index_t hint = left + (hal_index_t)((position - leftStartPosition) / avgLen);
+            getSegment()->setArrayIndex(genome, min(hint, right));
+        }
+    } else {
+        hal_index_t hint = (hal_index_t)min(nseg - 1., avgLen * ((double)position / (double)len));
+        getSegment()->setArrayIndex(genome, hint);
+    }
     assert(getSegment()->getArrayIndex() >= 0 && getSegment()->getArrayIndex() < nseg);
 
     while (overlaps(position) == false) {
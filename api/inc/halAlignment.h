@@ -21,6 +21,18 @@ namespace hal {
         }
     };
 
+    /**
+     * Expected pattern of access to an alignment or part of a genome.  This
+     * is only a hint that storage engines may use to tune read-ahead and
+     * caching; it doesn't change results.
+     */
+    enum AccessPattern {
+        ACCESS_NORMAL,     // no particular pattern, the default
+        ACCESS_SEQUENTIAL, // scanned in order, e.g. hal2maf
+        ACCESS_RANDOM,     // scattered lookups, e.g. liftover
+        ACCESS_WILLNEED    // will be read soon, start loading it now
+    };
+
     /**
      * Interface for a hierarhcical alignment.  Responsible for creating
      * and accessing genomes and tree information.  Accesssing a HAL file must
@@ -159,6 +171,11 @@ namespace hal {
 
         /** Replace the newick tree with a new string */
         virtual void replaceNewickTree(const std::string &newick) = 0;
+
+        /** Declare how the whole alignment will be accessed.  Ignored
+         * by storage engines that can't make use of it. */
+        virtual void setAccessPattern(AccessPattern pattern) const {
+        }
     };
 }
 #endif
@@ -60,6 +60,15 @@ namespace hal {
     static const size_t MMAP_DEFAULT_FILE_SIZE_GB = 64;
     static const size_t MMAP_DEFAULT_FILE_SIZE = 64 * GIGABYTE;
 
+    /*
+     * How DNA is stored in a new mmap file.
+     */
+    enum MMapDnaStorage {
+        MMAP_DNA_NIBBLE,     // four bits per base, accessed in place
+        MMAP_DNA_COMPRESSED, // four bits per base in compressed blocks
+        MMAP_DNA_TWOBIT      // two bits per base plus lists of N and lower-case runs
+    };
+
     /* get default FileCreatPropList with HAL default properties set */
     const H5::FileCreatPropList &hdf5DefaultFileCreatPropList();
 
@@ -92,9 +101,22 @@ namespace hal {
      * @param alignmentPath Path to file or URL for UDC access.
      * @param mode Access mode bit map
      * @param fileSize Size to allocate when creating new file (CREATE_ACCESS)
+     * @param dnaStorage How to store DNA (CREATE_ACCESS)
      */
     Alignment *mmapAlignmentInstance(const std::string &alignmentPath, unsigned mode = hal::READ_ACCESS,
-                                     size_t fileSize = hal::MMAP_DEFAULT_FILE_SIZE);
+                                     size_t fileSize = hal::MMAP_DEFAULT_FILE_SIZE,
+                                     MMapDnaStorage dnaStorage = MMAP_DNA_NIBBLE);
+
+    /** Rewrite an mmap alignment to a new file that contains only the live
+     * data, dropping space left behind by modifications.  Each genome's
+     * arrays are stored contiguously, in pre-order of the tree.  The DNA
+     * storage of the input is kept.
+     * @param inPath Path to existing file or URL
+     * @param outPath Path of file to create, must differ from inPath
+     * @param fileSize Initial size to allocate for the new file
+     */
+    void mmapCompactAlignment(const std::string &inPath, const std::string &outPath,
+                              size_t fileSize = hal::MMAP_DEFAULT_FILE_SIZE);
 
     /** Attempt to detect HAL alignment format, or return empty string if it doesn't
      * appear to be a hal file */
@@ -162,22 +162,44 @@ namespace hal {
         return _index < mmOther->_index;
     }
 
+    /* Strings are copied straight through the DnaAccess, checking the range
+     * once rather than for every base. */
     inline void DnaIterator::readString(std::string &outString, hal_size_t length) {
         assert(length == 0 || inRange() == true);
+        assert(_reversed ? (_index + 1 >= (hal_index_t)length)
+                         : (_index + length <= _genome->getSequenceLength()));
         outString.resize(length);
 
-        for (hal_size_t i = 0; i < length; ++i) {
-            outString[i] = getBase();
-            toRight();
+        if (_reversed) {
+            for (hal_size_t i = 0; i < length; ++i) {
+                outString[i] = reverseComplement(_dnaAccess->getBase(_index - i));
+            }
+            _index -= length;
+        } else {
+            for (hal_size_t i = 0; i < length; ++i) {
+                outString[i] = _dnaAccess->getBase(_index + i);
+            }
+            _index += length;
         }
     }
 
     inline void DnaIterator::writeString(const std::string &inString, hal_size_t length) {
-        assert(length == 0 || inRange());
+        if ((length > 0) and (not inRange() or (_reversed ? (_index + 1 < (hal_index_t)length)
+                                                          : (_index + length > _genome->getSequenceLength())))) {
+            throw hal_exception("Trying to set character out of range");
+        }
         for (hal_size_t i = 0; i < length; ++i) {
-            setBase(inString[i]);
-            toRight();
+            char c = inString[i];
+            if (not isNucleotide(c)) {
+                throw hal_exception(std::string("Trying to set invalid character: ") + c);
+            }
+            if (_reversed) {
+                _dnaAccess->setBase(_index - i, reverseComplement(c));
+            } else {
+                _dnaAccess->setBase(_index + i, c);
+            }
         }
+        _index += _reversed ? -(hal_index_t)length : (hal_index_t)length;
         flush();
     }
 }
@@ -23,6 +23,47 @@ namespace hal {
                                   const std::string &name);
     };
 
+    /**
+     * Fields of a run of consecutive top or bottom segments, stored
+     * column-wise, for copying segments in bulk rather than through
+     * iterators.
+     */
+    struct SegmentBlock {
+        hal_index_t _first;                        // array index of the first segment
+        hal_size_t _numChildren;                   // child links per bottom segment
+        std::vector<hal_index_t> _startPositions;  // each segment's start, then the end of the last
+        std::vector<hal_index_t> _parseIndexes;    // bottom parse index or top parse index
+        std::vector<hal_index_t> _linkIndexes;     // parent index, or _numChildren child indexes
+        std::vector<hal_index_t> _paralogyIndexes; // next paralogy index, top segments only
+        std::vector<char> _reversed;               // reversed flag of each parent or child link
+
+        SegmentBlock() : _first(0), _numChildren(0) {
+        }
+
+        /* size for count segments starting at first, each with numLinks
+         * parent or child links */
+        void resize(hal_index_t first, hal_size_t count, bool top, hal_size_t numLinks) {
+            _first = first;
+            _numChildren = top ? 0 : numLinks;
+            _startPositions.resize(count + 1);
+            _parseIndexes.resize(count);
+            _linkIndexes.resize(count * numLinks);
+            _paralogyIndexes.resize(top ? count : 0);
+            _reversed.resize(count * numLinks);
+        }
+
+        hal_size_t getNumSegments() const {
+            return _parseIndexes.size();
+        }
+
+        /* bytes of segment fields held */
+        size_t getBytes() const {
+            return (_startPositions.size() + _parseIndexes.size() + _linkIndexes.size() + _paralogyIndexes.size()) *
+                       sizeof(hal_index_t) +
+                   _reversed.size();
+        }
+    };
+
 
     /**
      * Interface for a genome within a hal alignment.  The genome
@@ -200,6 +241,42 @@ namespace hal {
         /** Rename this genome. */
         virtual void rename(const std::string &name) = 0;
 
+        /** Declare how a range of the genome's DNA and segments will be
+         * accessed.  Ignored by storage engines that can't make use of it.
+         * @param pattern expected access pattern
+         * @param start first position of the range
+         * @param length length of range, zero for the rest of the genome */
+        virtual void setAccessPattern(AccessPattern pattern, hal_index_t start = 0, hal_size_t length = 0) const {
+        }
+
+        /** Get a range of top or bottom segment indexes that includes the
+         * segment overlapping a position, from an index kept by the storage
+         * engine.  Used to speed up searches by position.
+         * @param top search top segments rather than bottom segments
+         * @param position position in genome
+         * @param first set to the first segment index of the range
+         * @param last set to the last segment index of the range
+         * @return false if there is no index */
+        virtual bool getSegmentIndexRange(bool top, hal_index_t position, hal_index_t &first, hal_index_t &last) const {
+            return false;
+        }
+
+        /** Read a run of top or bottom segments into a block, for copying
+         * segments in bulk.  Storage engines that can read a segment array
+         * directly override the default, which uses segment iterators.
+         * @param top read top segments rather than bottom segments
+         * @param first index of the first segment
+         * @param count number of segments
+         * @param block set to the fields of the segments */
+        virtual void getSegmentBlock(bool top, hal_index_t first, hal_size_t count, SegmentBlock &block) const;
+
+        /** Write a block of top or bottom segments, such as one read by
+         * getSegmentBlock() from a genome with the same dimensions.
+         * @param top write top segments rather than bottom segments
+         * @param block segments to write, with the same number of child
+         * links per bottom segment as this genome */
+        virtual void setSegmentBlock(bool top, const SegmentBlock &block);
+
         /** Reload the genome after some aspect has changed, clearing any caches. */
         void reload() {
             _numChildren = _alignment->getChildNames(_name).size();
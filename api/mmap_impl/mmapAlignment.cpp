@@ -1,5 +1,9 @@
 #include "mmapAlignment.h"
+#include "halBottomSegmentIterator.h"
 #include "halCLParser.h"
+#include "halSequenceIterator.h"
+#include "halTopSegmentIterator.h"
+#include "mmapDnaBlocks.h"
 #include "mmapGenome.h"
 
 using namespace hal;
@@ -7,9 +11,11 @@ using namespace std;
 
 static const int NAME_HASH_GROWTH_FACTOR = 1024; // allow lots of initial space
 
-MMapAlignment::MMapAlignment(const std::string &alignmentPath, unsigned mode, size_t fileSize)
-    : _alignmentPath(alignmentPath), _mode(mode), _fileSize(fileSize), _file(NULL), _data(NULL), _genomeNameHash(NULL),
-      _tree(NULL) {
+static const hal_size_t COMPACT_DNA_CHUNK_SIZE = 1 << 20; // bases copied at a time by compact()
+
+MMapAlignment::MMapAlignment(const std::string &alignmentPath, unsigned mode, size_t fileSize, MMapDnaStorage dnaStorage)
+    : _alignmentPath(alignmentPath), _mode(mode), _fileSize(fileSize), _dnaStorage(dnaStorage),
+      _memoryMode(MMAP_MEMORY_MAPPED), _file(NULL), _data(NULL), _genomeNameHash(NULL), _tree(NULL) {
     _file = MMapFile::factory(alignmentPath, mode, fileSize);
     if (mode & CREATE_ACCESS) {
         create();
@@ -19,10 +25,10 @@ MMapAlignment::MMapAlignment(const std::string &alignmentPath, unsigned mode, si
 }
 
 MMapAlignment::MMapAlignment(const std::string &alignmentPath, unsigned mode, const CLParser *parser)
-    : _alignmentPath(alignmentPath), _mode(halDefaultAccessMode(mode)), _fileSize(0), _file(NULL), _data(NULL),
-      _genomeNameHash(NULL), _tree(NULL) {
+    : _alignmentPath(alignmentPath), _mode(halDefaultAccessMode(mode)), _fileSize(0), _dnaStorage(MMAP_DNA_NIBBLE),
+      _memoryMode(MMAP_MEMORY_MAPPED), _file(NULL), _data(NULL), _genomeNameHash(NULL), _tree(NULL) {
     initializeFromOptions(parser);
-    _file = MMapFile::factory(alignmentPath, _mode, _fileSize);
+    _file = MMapFile::factory(alignmentPath, _mode, _fileSize, _memoryMode);
     if (mode & CREATE_ACCESS) {
         create();
     } else {
@@ -31,7 +37,14 @@ MMapAlignment::MMapAlignment(const std::string &alignmentPath, unsigned mode, co
 }
 
 void MMapAlignment::close() {
-    // Free the memory used by all open genomes.
+    // Write DNA buffered in memory and missing site indexes, then free the
+    // memory used by all open genomes.
+    if (not isReadOnly()) {
+        for (auto kv : _openGenomes) {
+            kv.second->writeDnaBuffer();
+            kv.second->writeSiteIndexes();
+        }
+    }
     for (auto kv : _openGenomes) {
         delete kv.second;
     }
@@ -43,16 +56,33 @@ void MMapAlignment::close() {
 
 void MMapAlignment::defineOptions(CLParser *parser, unsigned mode) {
     if (mode & CREATE_ACCESS) {
-        parser->addOption("mmapFileSize", "mmap HAL file initial size (in gigabytes)", MMAP_DEFAULT_FILE_SIZE_GB);
+        parser->addOption("mmapFileSize", "mmap HAL file initial size (in gigabytes), the file is grown as needed", MMAP_DEFAULT_FILE_SIZE_GB);
+        parser->addOptionFlag("mmapCompressDna", "store DNA in compressed blocks in mmap HAL file", false);
+        parser->addOptionFlag("mmapTwoBitDna", "store DNA as two bits per base plus N and lower-case runs in mmap HAL file",
+                              false);
     } else if (mode & WRITE_ACCESS) {
         parser->addOption("mmapSizeIncrease", "additional space to reserve at end of file (in gigabytes)", 1);
     }
+    // apply to mmap files opened read-only, such as the input of a tool
+    // creating a file
+    parser->addOptionFlag("mmapInMemory", "copy mmap HAL files opened read-only into memory backed by huge pages", false);
+    parser->addOptionFlag("mmapSharedMemory",
+                          "copy mmap HAL files opened read-only into shared memory (/dev/shm) that is reused by other "
+                          "processes opening the same file, until removed",
+                          false);
 }
 
 /* initialize class from options */
 void MMapAlignment::initializeFromOptions(const CLParser *parser) {
     if (_mode & CREATE_ACCESS) {
         _fileSize = GIGABYTE * parser->get<size_t>("mmapFileSize");
+        if (parser->getFlag("mmapCompressDna") && parser->getFlag("mmapTwoBitDna")) {
+            throw hal_exception("--mmapCompressDna and --mmapTwoBitDna are mutually exclusive");
+        } else if (parser->getFlag("mmapCompressDna")) {
+            _dnaStorage = MMAP_DNA_COMPRESSED;
+        } else if (parser->getFlag("mmapTwoBitDna")) {
+            _dnaStorage = MMAP_DNA_TWOBIT;
+        }
     } else if (_mode & WRITE_ACCESS) {
         // TODO: this causes _fileSize's meaning to be far too
         // overloaded: sometimes (CREATE_ACCESS) it is a requested
@@ -62,6 +92,100 @@ void MMapAlignment::initializeFromOptions(const CLParser *parser) {
         // 3 separate factory functions.
         _fileSize = GIGABYTE * parser->get<size_t>("mmapSizeIncrease");
     }
+    if ((_mode & WRITE_ACCESS) == 0) {
+        if (parser->getFlag("mmapInMemory") && parser->getFlag("mmapSharedMemory")) {
+            throw hal_exception("--mmapInMemory and --mmapSharedMemory are mutually exclusive");
+        } else if (parser->getFlag("mmapInMemory")) {
+            _memoryMode = MMAP_MEMORY_PRIVATE;
+        } else if (parser->getFlag("mmapSharedMemory")) {
+            _memoryMode = MMAP_MEMORY_SHARED;
+        }
+    }
+}
+
+/* Copy a genome's sequences, DNA, segments and metadata to a genome of
+ * the same name and position in the tree of another alignment.  Segment
+ * indexes are copied as-is, as sequences keep their order. */
+static void compactGenome(const MMapGenome *inGenome, MMapGenome *outGenome) {
+    vector<Sequence::Info> dimensions;
+    for (SequenceIteratorPtr seqIt = inGenome->getSequenceIterator(0); not seqIt->atEnd(); seqIt->toNext()) {
+        const Sequence *sequence = seqIt->getSequence();
+        dimensions.push_back(Sequence::Info(sequence->getName(), sequence->getSequenceLength(),
+                                            sequence->getNumTopSegments(), sequence->getNumBottomSegments()));
+    }
+    outGenome->setDimensions(dimensions, true);
+
+    string dna;
+    hal_size_t sequenceLength = inGenome->getSequenceLength();
+    for (hal_size_t start = 0; start < sequenceLength; start += COMPACT_DNA_CHUNK_SIZE) {
+        hal_size_t length = min(COMPACT_DNA_CHUNK_SIZE, sequenceLength - start);
+        inGenome->getSubString(dna, start, length);
+        outGenome->setSubString(dna, start, length);
+    }
+
+    TopSegmentIteratorPtr inTop = inGenome->getTopSegmentIterator(0);
+    TopSegmentIteratorPtr outTop = outGenome->getTopSegmentIterator(0);
+    for (hal_size_t i = 0; i < inGenome->getNumTopSegments(); ++i, inTop->toRight(), outTop->toRight()) {
+        outTop->setCoordinates(inTop->getStartPosition(), inTop->getLength());
+        outTop->tseg()->setParentIndex(inTop->tseg()->getParentIndex());
+        outTop->tseg()->setParentReversed(inTop->tseg()->getParentReversed());
+        outTop->tseg()->setBottomParseIndex(inTop->tseg()->getBottomParseIndex());
+        outTop->tseg()->setNextParalogyIndex(inTop->tseg()->getNextParalogyIndex());
+    }
+
+    BottomSegmentIteratorPtr inBot = inGenome->getBottomSegmentIterator(0);
+    BottomSegmentIteratorPtr outBot = outGenome->getBottomSegmentIterator(0);
+    hal_size_t numChildren = inGenome->getNumChildren();
+    for (hal_size_t i = 0; i < inGenome->getNumBottomSegments(); ++i, inBot->toRight(), outBot->toRight()) {
+        outBot->setCoordinates(inBot->getStartPosition(), inBot->getLength());
+        for (hal_size_t child = 0; child < numChildren; ++child) {
+            outBot->bseg()->setChildIndex(child, inBot->bseg()->getChildIndex(child));
+            outBot->bseg()->setChildReversed(child, inBot->bseg()->getChildReversed(child));
+        }
+        outBot->bseg()->setTopParseIndex(inBot->bseg()->getTopParseIndex());
+    }
+
+    for (const auto &kv : inGenome->getMetaData()->getMap()) {
+        outGenome->getMetaData()->set(kv.first, kv.second);
+    }
+
+    // write the rest of the genome now so that it is stored contiguously
+    outGenome->releaseDnaBuffer();
+    outGenome->writeSiteIndexes();
+}
+
+/* Genomes are added to the new file before any are copied, so the tree,
+ * genome array and name hash that are reallocated as genomes are added
+ * come first, followed by each genome's arrays in pre-order.  Space left
+ * behind by earlier modifications of the input file is not copied. */
+void MMapAlignment::compact(const std::string &inPath, const std::string &outPath, size_t fileSize) {
+    MMapAlignment inAlignment(inPath, READ_ACCESS);
+    MMapDnaStorage dnaStorage = MMAP_DNA_NIBBLE;
+    if (inAlignment.getDnaBlockSize() != 0) {
+        dnaStorage = MMAP_DNA_COMPRESSED;
+    } else if (inAlignment.isDnaTwoBit()) {
+        dnaStorage = MMAP_DNA_TWOBIT;
+    }
+    MMapAlignment outAlignment(outPath, CREATE_ACCESS, fileSize, dnaStorage);
+    vector<string> genomeNames;
+    if (inAlignment.getNumGenomes() > 0) {
+        genomeNames.push_back(inAlignment.getRootName());
+        outAlignment.addRootGenome(genomeNames.front(), 0);
+    }
+    for (size_t i = 0; i < genomeNames.size(); ++i) {
+        // insert children after their parent to keep pre-order
+        vector<string> childNames = inAlignment.getChildNames(genomeNames[i]);
+        for (const string &childName : childNames) {
+            outAlignment.addLeafGenome(childName, genomeNames[i], inAlignment.getBranchLength(genomeNames[i], childName));
+        }
+        genomeNames.insert(genomeNames.begin() + i + 1, childNames.begin(), childNames.end());
+    }
+    for (const string &genomeName : genomeNames) {
+        compactGenome(static_cast<const MMapGenome *>(inAlignment.openGenome(genomeName)),
+                      static_cast<MMapGenome *>(outAlignment.openGenome(genomeName)));
+    }
+    outAlignment.close();
+    inAlignment.close();
 }
 
 void MMapAlignment::create() {
@@ -69,6 +193,8 @@ void MMapAlignment::create() {
     _data = static_cast<MMapAlignmentData *>(resolveOffset(_file->getRootOffset(), sizeof(MMapAlignmentData)));
     _data->_numGenomes = 0;
     _data->_genomeNameHashOffset = MMAP_NULL_OFFSET;
+    _data->_dnaBlockSize = (_dnaStorage == MMAP_DNA_COMPRESSED) ? MMAP_DNA_BLOCK_SIZE : 0;
+    _data->_dnaTwoBit = (_dnaStorage == MMAP_DNA_TWOBIT);
 }
 
 void MMapAlignment::open() {
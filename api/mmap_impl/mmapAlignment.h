@@ -27,7 +27,9 @@ namespace hal {
         size_t _newickStringLength;
         size_t _genomeArrayOffset;
         size_t _genomeNameHashOffset;
-        char _reserved[265];   // 256 bytes of reserved added in mmap API 1.1
+        hal_size_t _dnaBlockSize; // bases per compressed DNA block, 0 if not compressed (mmap API 1.3)
+        hal_size_t _dnaTwoBit;    // non-zero if DNA is stored as 2-bit bases and runs (mmap API 1.4)
+        char _reserved[249];      // 256 bytes of reserved added in mmap API 1.1
     };
 
     class MMapAlignment : public Alignment {
@@ -35,7 +37,8 @@ namespace hal {
 
       public:
         /* constructor with all arguments specified */
-        MMapAlignment(const std::string &alignmentPath, unsigned mode = READ_ACCESS, size_t fileSize = MMAP_DEFAULT_FILE_SIZE);
+        MMapAlignment(const std::string &alignmentPath, unsigned mode = READ_ACCESS, size_t fileSize = MMAP_DEFAULT_FILE_SIZE,
+                      MMapDnaStorage dnaStorage = MMAP_DNA_NIBBLE);
 
         /* constructor from command line options */
         MMapAlignment(const std::string &alignmentPath, unsigned mode, const CLParser *parser);
@@ -47,6 +50,9 @@ namespace hal {
         };
         static void defineOptions(CLParser *parser, unsigned mode);
 
+        /* copy the live data of an alignment to a new file, in tree order */
+        static void compact(const std::string &inPath, const std::string &outPath, size_t fileSize);
+
         // Allocate new array and return the offset.
         size_t allocateNewArray(size_t size) const {
             return _file->allocMem(size, false);
@@ -54,6 +60,9 @@ namespace hal {
         void *resolveOffset(size_t offset, size_t len) const {
             return _file->toPtr(offset, len);
         };
+        void adviseAccess(size_t offset, size_t len, AccessPattern pattern) const {
+            _file->adviseAccess(offset, len, pattern);
+        };
 
         void close();
 
@@ -64,6 +73,16 @@ namespace hal {
             return _file;
         }
 
+        /* bases per block of compressed DNA, or 0 if DNA is not compressed */
+        hal_size_t getDnaBlockSize() const {
+            return (_file->getMinorVersion() >= 3) ? _data->_dnaBlockSize : 0;
+        }
+
+        /* is DNA stored as 2-bit bases with N and lower-case runs? */
+        bool isDnaTwoBit() const {
+            return (_file->getMinorVersion() >= 4) && (_data->_dnaTwoBit != 0);
+        }
+
         Genome *addLeafGenome(const std::string &name, const std::string &parentName, double branchLength);
 
         Genome *addRootGenome(const std::string &name, double branchLength);
@@ -200,6 +219,10 @@ namespace hal {
             loadTree();
         };
 
+        void setAccessPattern(AccessPattern pattern) const {
+            _file->adviseAccess(0, SIZE_MAX, pattern);
+        }
+
       private:
         void initializeFromOptions(const CLParser *parser);
         void create();
@@ -232,6 +255,8 @@ namespace hal {
         std::string _alignmentPath;
         unsigned _mode;
         size_t _fileSize;
+        MMapDnaStorage _dnaStorage;
+        MMapMemoryMode _memoryMode;
         MMapFile *_file;
         MMapAlignmentData *_data;
         MMapPerfectHashTable *_genomeNameHash;
@@ -2,26 +2,28 @@
 #define _MMAPBOTTOMSEGMENT_H
 #include "halBottomSegment.h"
 #include "halGenome.h"
-#include "mmapBottomSegmentData.h"
 #include "mmapGenome.h"
+#include "mmapSegmentArray.h"
 #include <cassert>
 
 namespace hal {
     class MMapBottomSegment : public BottomSegment {
       public:
         MMapBottomSegment(MMapGenome *genome, hal_index_t arrayIndex)
-            : BottomSegment(genome, arrayIndex), _data(genome->getBottomSegmentPointer(arrayIndex)) {
+            : BottomSegment(genome, arrayIndex), _array(genome->getBottomSegmentArray()),
+              _data(_array->getLegacyData(arrayIndex)) {
         }
 
         // SEGMENT INTERFACE
         void setArrayIndex(Genome *genome, hal_index_t arrayIndex) {
             _genome = genome;
-            _data = getMMapGenome()->getBottomSegmentPointer(arrayIndex);
+            _array = getMMapGenome()->getBottomSegmentArray();
+            _data = _array->getLegacyData(arrayIndex);
             _index = arrayIndex;
         };
         const Sequence *getSequence() const;
         hal_index_t getStartPosition() const {
-            return _data->getStartPosition();
+            return (_data != NULL) ? _data->getStartPosition() : _array->getStartPosition(_index);
         };
         hal_index_t getEndPosition() const;
         hal_size_t getLength() const;
@@ -34,25 +36,38 @@ namespace hal {
         // BOTTOM SEGMENT INTERFACE
         hal_size_t getNumChildren() const;
         hal_index_t getChildIndex(hal_size_t i) const {
-            return _data->getChildIndex(i);
+            return (_data != NULL) ? _data->getChildIndex(i) : _array->getChildIndex(_index, i);
         };
         hal_index_t getChildIndexG(const Genome *childGenome) const;
         bool hasChild(hal_size_t child) const;
         bool hasChildG(const Genome *childGenome) const;
         void setChildIndex(hal_size_t i, hal_index_t childIndex) {
-            _data->setChildIndex(i, childIndex);
+            if (_data != NULL) {
+                _data->setChildIndex(i, childIndex);
+            } else {
+                _array->setChildIndex(_index, i, childIndex);
+            }
         };
         bool getChildReversed(hal_size_t i) const {
-            return _data->getChildReversed(_genome->getNumChildren(), i);
+            return (_data != NULL) ? _data->getChildReversed(_genome->getNumChildren(), i)
+                                 : _array->getChildReversed(_index, i);
         };
         void setChildReversed(hal_size_t child, bool isReversed) {
-            _data->setChildReversed(_genome->getNumChildren(), child, isReversed);
+            if (_data != NULL) {
+                _data->setChildReversed(_genome->getNumChildren(), child, isReversed);
+            } else {
+                _array->setChildReversed(_index, child, isReversed);
+            }
         };
         hal_index_t getTopParseIndex() const {
-            return _data->getTopParseIndex();
+            return (_data != NULL) ? _data->getTopParseIndex() : _array->getTopParseIndex(_index);
         };
         void setTopParseIndex(hal_index_t parseIndex) {
-            _data->setTopParseIndex(parseIndex);
+            if (_data != NULL) {
+                _data->setTopParseIndex(parseIndex);
+            } else {
+                _array->setTopParseIndex(_index, parseIndex);
+            }
         };
         hal_offset_t getTopParseOffset() const;
         bool hasParseUp() const;
@@ -68,7 +83,8 @@ namespace hal {
         MMapBottomSegmentData *getNextData() const {
             return (MMapBottomSegmentData *)(((char *)_data) + MMapBottomSegmentData::getSize(_genome));
         };
-        MMapBottomSegmentData *_data;
+        MMapBottomSegmentArray *_array;
+        MMapBottomSegmentData *_data; // NULL unless file predates columnar segments
     };
 
     inline hal_index_t MMapBottomSegment::getEndPosition() const {
@@ -76,7 +92,10 @@ namespace hal {
     }
 
     inline hal_size_t MMapBottomSegment::getLength() const {
-        return getNextData()->getStartPosition() - _data->getStartPosition();
+        if (_data != NULL) {
+            return getNextData()->getStartPosition() - _data->getStartPosition();
+        }
+        return _array->getStartPosition(_index + 1) - _array->getStartPosition(_index);
     }
 
     inline const Sequence *MMapBottomSegment::getSequence() const {
@@ -0,0 +1,131 @@
+#include "mmapDnaBlocks.h"
+#include "mmapAlignment.h"
+#include <cstring>
+#include <zlib.h>
+
+using namespace hal;
+using namespace std;
+
+/* constructor, loading the header */
+MMapDnaBlocks::MMapDnaBlocks(MMapAlignment *alignment, size_t offset) : _alignment(alignment) {
+    _header = *static_cast<const MMapDnaBlocksData *>(_alignment->resolveOffset(offset, sizeof(MMapDnaBlocksData)));
+}
+
+/* Compress each block into a scratch buffer and append it to the file.
+ * Blocks are allocated one at a time so that the whole compressed genome
+ * is never held in memory. */
+size_t MMapDnaBlocks::write(MMapAlignment *alignment, const vector<char> &packedDna, hal_size_t sequenceLength,
+                            hal_size_t blockSize) {
+    assert((blockSize % 2) == 0);
+    assert(packedDna.size() == (sequenceLength + 1) / 2);
+    MMapDnaBlocksData header;
+    memset(&header, 0, sizeof(header));
+    header._sequenceLength = sequenceLength;
+    header._blockSize = blockSize;
+    header._numBlocks = (sequenceLength + blockSize - 1) / blockSize;
+    size_t headerOffset = alignment->allocateNewArray(sizeof(MMapDnaBlocksData));
+    header._blockOffsetsOffset = alignment->allocateNewArray(header._numBlocks * sizeof(size_t));
+    header._blockLengthsOffset = alignment->allocateNewArray(header._numBlocks * sizeof(uint32_t));
+    *static_cast<MMapDnaBlocksData *>(alignment->resolveOffset(headerOffset, sizeof(MMapDnaBlocksData))) = header;
+
+    // Run-length matching only: packed bases have few long matches, except
+    // for runs such as N gaps, and this inflates much faster than full LZ77.
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, 15, 8, Z_RLE) != Z_OK) {
+        throw hal_exception("DNA block compression initialization failed");
+    }
+    size_t packedBlockSize = blockSize / 2;
+    vector<Bytef> compressed(deflateBound(&stream, packedBlockSize));
+    for (hal_size_t i = 0; i < header._numBlocks; i++) {
+        const char *src = packedDna.data() + i * packedBlockSize;
+        size_t srcLength = min(packedBlockSize, packedDna.size() - i * packedBlockSize);
+        deflateReset(&stream);
+        stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(src));
+        stream.avail_in = srcLength;
+        stream.next_out = compressed.data();
+        stream.avail_out = compressed.size();
+        if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+            deflateEnd(&stream);
+            throw hal_exception("DNA block compression failed");
+        }
+        size_t length = stream.total_out;
+        if (length >= srcLength) {
+            // incompressible, store as is
+            length = srcLength;
+            memcpy(compressed.data(), src, srcLength);
+        }
+        size_t blockOffset = alignment->allocateNewArray(length);
+        memcpy(alignment->resolveOffset(blockOffset, length), compressed.data(), length);
+        *static_cast<size_t *>(alignment->resolveOffset(header._blockOffsetsOffset + i * sizeof(size_t), sizeof(size_t))) =
+            blockOffset;
+        *static_cast<uint32_t *>(
+            alignment->resolveOffset(header._blockLengthsOffset + i * sizeof(uint32_t), sizeof(uint32_t))) = length;
+    }
+    deflateEnd(&stream);
+    return headerOffset;
+}
+
+size_t MMapDnaBlocks::getBlockOffset(hal_size_t blockIndex) const {
+    return *static_cast<const size_t *>(
+        _alignment->resolveOffset(_header._blockOffsetsOffset + blockIndex * sizeof(size_t), sizeof(size_t)));
+}
+
+uint32_t MMapDnaBlocks::getBlockLength(hal_size_t blockIndex) const {
+    return *static_cast<const uint32_t *>(
+        _alignment->resolveOffset(_header._blockLengthsOffset + blockIndex * sizeof(uint32_t), sizeof(uint32_t)));
+}
+
+/* bytes of packed DNA in a block, the last one may be short */
+size_t MMapDnaBlocks::getPackedBlockSize(hal_size_t blockIndex) const {
+    size_t packedBlockSize = _header._blockSize / 2;
+    return min(packedBlockSize, ((_header._sequenceLength + 1) / 2) - blockIndex * packedBlockSize);
+}
+
+/* decompress a block into dest, which must hold getPackedBlockSize() bytes */
+void MMapDnaBlocks::decompress(hal_size_t blockIndex, char *dest) const {
+    assert(blockIndex < _header._numBlocks);
+    uint32_t length = getBlockLength(blockIndex);
+    const Bytef *src = static_cast<const Bytef *>(_alignment->resolveOffset(getBlockOffset(blockIndex), length));
+    uLongf destLength = getPackedBlockSize(blockIndex);
+    if (length == destLength) {
+        memcpy(dest, src, length);
+    } else if ((uncompress(reinterpret_cast<Bytef *>(dest), &destLength, src, length) != Z_OK) ||
+               (destLength != getPackedBlockSize(blockIndex))) {
+        throw hal_exception("corrupt compressed DNA block " + std::to_string(blockIndex));
+    }
+}
+
+MMapDnaBlocks::BlockPtr MMapDnaBlocks::getBlock(hal_size_t blockIndex) const {
+    for (auto it = _cache.begin(); it != _cache.end(); ++it) {
+        if (it->first == blockIndex) {
+            _cache.splice(_cache.begin(), _cache, it);
+            return it->second;
+        }
+    }
+    // blocks still referenced by a DnaAccess stay alive after eviction
+    BlockPtr block(new vector<char>(getPackedBlockSize(blockIndex)));
+    decompress(blockIndex, block->data());
+    _cache.push_front(make_pair(blockIndex, block));
+    if (_cache.size() > MMAP_DNA_BLOCK_CACHE_SIZE) {
+        _cache.pop_back();
+    }
+    return block;
+}
+
+void MMapDnaBlocks::readAll(vector<char> &packedDna) const {
+    packedDna.resize((_header._sequenceLength + 1) / 2);
+    for (hal_size_t i = 0; i < _header._numBlocks; i++) {
+        decompress(i, packedDna.data() + i * (_header._blockSize / 2));
+    }
+}
+
+void MMapDnaBlocks::adviseAccess(hal_index_t start, hal_index_t end, AccessPattern pattern) const {
+    if (_header._numBlocks == 0) {
+        return;
+    }
+    hal_size_t firstBlock = start / _header._blockSize, lastBlock = end / _header._blockSize;
+    size_t firstOffset = getBlockOffset(firstBlock);
+    size_t endOffset = getBlockOffset(lastBlock) + getBlockLength(lastBlock);
+    _alignment->adviseAccess(firstOffset, endOffset - firstOffset, pattern);
+}
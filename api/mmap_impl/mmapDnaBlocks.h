@@ -0,0 +1,77 @@
+#ifndef _MMAPDNABLOCKS_H
+#define _MMAPDNABLOCKS_H
+#include "halAlignment.h"
+#include "halDefs.h"
+#include <list>
+#include <memory>
+#include <vector>
+
+namespace hal {
+    class MMapAlignment;
+
+    /* bases per block of compressed DNA, must be even */
+    static const hal_size_t MMAP_DNA_BLOCK_SIZE = 64 * 1024;
+
+    /* number of decompressed blocks cached per genome */
+    static const size_t MMAP_DNA_BLOCK_CACHE_SIZE = 16;
+
+    /* header of a genome's block-compressed DNA, added in mmap API 1.3 */
+    class MMapDnaBlocksData {
+      public:
+        hal_size_t _sequenceLength;   // number of bases
+        hal_size_t _blockSize;        // bases per block
+        hal_size_t _numBlocks;        // number of blocks
+        size_t _blockOffsetsOffset;   // file offset of each compressed block
+        size_t _blockLengthsOffset;   // uint32_t compressed length of each block
+        char _reserved[64];
+    };
+
+    /**
+     * Nibble-packed DNA of a genome stored as independently deflated
+     * blocks of a fixed number of bases, so any base can be read by
+     * decompressing one block.  A block that doesn't shrink is stored
+     * uncompressed.  Decompressed blocks are kept in an LRU cache.
+     */
+    class MMapDnaBlocks {
+      public:
+        typedef std::shared_ptr<std::vector<char>> BlockPtr;
+
+        MMapDnaBlocks(MMapAlignment *alignment, size_t offset);
+
+        /* compress packed DNA and write it to the file, returning the
+         * offset of the header */
+        static size_t write(MMapAlignment *alignment, const std::vector<char> &packedDna, hal_size_t sequenceLength,
+                            hal_size_t blockSize);
+
+        hal_size_t getBlockSize() const {
+            return _header._blockSize;
+        }
+        hal_size_t getSequenceLength() const {
+            return _header._sequenceLength;
+        }
+
+        /* get the packed DNA of a block, decompressing it if not cached */
+        BlockPtr getBlock(hal_size_t blockIndex) const;
+
+        /* decompress all of the DNA into packedDna */
+        void readAll(std::vector<char> &packedDna) const;
+
+        /* pass an access pattern hint for the blocks holding bases start
+         * to end to the file */
+        void adviseAccess(hal_index_t start, hal_index_t end, AccessPattern pattern) const;
+
+      private:
+        size_t getBlockOffset(hal_size_t blockIndex) const;
+        uint32_t getBlockLength(hal_size_t blockIndex) const;
+        size_t getPackedBlockSize(hal_size_t blockIndex) const;
+        void decompress(hal_size_t blockIndex, char *dest) const;
+
+        MMapAlignment *_alignment;
+        MMapDnaBlocksData _header;
+        mutable std::list<std::pair<hal_size_t, BlockPtr>> _cache; // most recently used first
+    };
+}
+#endif
+// Local Variables:
+// mode: c++
+// End:
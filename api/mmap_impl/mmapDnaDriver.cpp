@@ -14,8 +14,23 @@ static const int UDC_FETCH_SIZE = 64 * 1024; // size to bring in for UDC access
 
 MMapDnaAccess::MMapDnaAccess(MMapGenome *genome, hal_index_t index)
     : DnaAccess(0, 0, NULL), _genome(genome),
-      _isUdcProtocol(dynamic_cast<MMapAlignment *>(_genome->getAlignment())->getMMapFile()->isUdcProtocol()) {
-    if (_isUdcProtocol) {
+      _isUdcProtocol(dynamic_cast<MMapAlignment *>(_genome->getAlignment())->getMMapFile()->isUdcProtocol()),
+      _blocks(NULL), _twoBit(NULL) {
+    if (_genome->isDnaBuffered()) {
+        if (_genome->getAlignment()->isReadOnly()) {
+            // blocks or windows are fetched on first access
+            if (_genome->getSequenceLength() == 0) {
+                // nothing to fetch
+            } else if (_genome->isDnaCompressed()) {
+                _blocks = _genome->getDnaBlocks();
+            } else {
+                _twoBit = _genome->getDnaTwoBit();
+            }
+        } else {
+            _endIndex = _genome->getSequenceLength();
+            _buffer = _genome->getDnaBuffer().data();
+        }
+    } else if (_isUdcProtocol) {
         fetch(index);
     } else {
         // for local mmap, just include the whole thing
@@ -25,12 +40,26 @@ MMapDnaAccess::MMapDnaAccess(MMapGenome *genome, hal_index_t index)
 }
 
 void MMapDnaAccess::flush() {
-    // kernel handles page out
+    // kernel handles page out of mapped DNA, buffered DNA is written on close
+    if (_dirty && _genome->isDnaBuffered()) {
+        _genome->markDnaBufferDirty();
+    }
     _dirty = false;
 }
 
 void MMapDnaAccess::fetch(hal_index_t index) const {
-    if (_isUdcProtocol) {
+    if (_blocks != NULL) {
+        hal_size_t blockSize = _blocks->getBlockSize();
+        _block = _blocks->getBlock(index / blockSize);
+        _startIndex = (index / blockSize) * blockSize;
+        _endIndex = std::min(_startIndex + blockSize, _blocks->getSequenceLength());
+        _buffer = _block->data();
+    } else if (_twoBit != NULL) {
+        _window = _twoBit->getWindow(index / MMAP_DNA_TWOBIT_WINDOW_SIZE);
+        _startIndex = (index / MMAP_DNA_TWOBIT_WINDOW_SIZE) * MMAP_DNA_TWOBIT_WINDOW_SIZE;
+        _endIndex = std::min(_startIndex + MMAP_DNA_TWOBIT_WINDOW_SIZE, _twoBit->getSequenceLength());
+        _buffer = _window->data();
+    } else if (_isUdcProtocol) {
         _startIndex = 2 * (index / 2); // even boundary
         _endIndex = std::max(hal_size_t(_startIndex + UDC_FETCH_SIZE), _genome->getSequenceLength());
         _buffer = _genome->getDNA(_startIndex / 2, (((_endIndex - _startIndex) + 1) / 2));
@@ -7,13 +7,18 @@
 #ifndef _MMAPDNADRIVER_H
 #define _MMAPDNADRIVER_H
 #include "halDnaDriver.h"
+#include "mmapDnaBlocks.h"
+#include "mmapDnaTwoBit.h"
 
 namespace hal {
     class MMapGenome;
     class MMapAlignment;
 
     /**
-     * Mmap implementation of DnaAccess.
+     * Mmap implementation of DnaAccess.  Uncompressed DNA is accessed directly
+     * in the mapped file.  Compressed DNA is read a block at a time and 2-bit
+     * DNA is decoded a window at a time, or either is accessed in the genome's
+     * in-memory copy when the file is open for write.
      */
     class MMapDnaAccess : public DnaAccess {
       public:
@@ -30,6 +35,10 @@ namespace hal {
       private:
         MMapGenome *_genome;
         bool _isUdcProtocol;
+        const MMapDnaBlocks *_blocks;             // compressed DNA read a block at a time
+        mutable MMapDnaBlocks::BlockPtr _block;   // current block, kept even if evicted from cache
+        const MMapDnaTwoBit *_twoBit;             // 2-bit DNA decoded a window at a time
+        mutable MMapDnaTwoBit::WindowPtr _window; // current window, kept even if evicted from cache
     };
 }
 
@@ -0,0 +1,177 @@
+#include "mmapDnaTwoBit.h"
+#include "mmapAlignment.h"
+#include <cstring>
+
+using namespace hal;
+using namespace std;
+
+/* nibble codes of the DnaAccess encoding */
+static const uint8_t NIBBLE_UPPER_BIT = 0x8;
+static const uint8_t NIBBLE_N = 0x4;
+
+/* Map of a byte of four 2-bit bases to the two bytes of upper-case
+ * nibbles they decode to */
+class DecodeMap {
+  public:
+    DecodeMap() {
+        memset(_map, 0, sizeof(_map));
+        for (int b = 0; b < 256; b++) {
+            for (int i = 0; i < 4; i++) {
+                uint8_t code = NIBBLE_UPPER_BIT | ((b >> (6 - 2 * i)) & 0x3);
+                _map[b][i / 2] |= (i & 1) ? code : (code << 4);
+            }
+        }
+    }
+    uint8_t _map[256][2];
+};
+static const DecodeMap decodeMap;
+
+/* update nibbles first to last (exclusive) of dest */
+static void updateNibbles(char *dest, hal_index_t first, hal_index_t last, uint8_t andMask, uint8_t orMask) {
+    hal_index_t i = first;
+    if ((i & 1) && (i < last)) {
+        dest[i / 2] = (dest[i / 2] & (0xF0 | andMask)) | orMask;
+        i++;
+    }
+    uint8_t andByte = (andMask << 4) | andMask, orByte = (orMask << 4) | orMask;
+    for (; i + 1 < last; i += 2) {
+        dest[i / 2] = (dest[i / 2] & andByte) | orByte;
+    }
+    if (i < last) {
+        dest[i / 2] = (dest[i / 2] & ((andMask << 4) | 0x0F)) | (orMask << 4);
+    }
+}
+
+/* add a base to a run list, extending the last run if adjacent */
+static void addToRuns(vector<MMapDnaRun> &runs, hal_index_t position) {
+    if (runs.empty() || (runs.back()._start + hal_index_t(runs.back()._length) != position)) {
+        runs.push_back({position, 0});
+    }
+    runs.back()._length++;
+}
+
+/* copy runs to a newly allocated array */
+static size_t writeRuns(MMapAlignment *alignment, const vector<MMapDnaRun> &runs) {
+    size_t size = runs.size() * sizeof(MMapDnaRun);
+    size_t offset = alignment->allocateNewArray(size);
+    if (size > 0) {
+        memcpy(alignment->resolveOffset(offset, size), runs.data(), size);
+    }
+    return offset;
+}
+
+/* constructor, loading the header */
+MMapDnaTwoBit::MMapDnaTwoBit(MMapAlignment *alignment, size_t offset) : _alignment(alignment) {
+    _header = *static_cast<const MMapDnaTwoBitData *>(_alignment->resolveOffset(offset, sizeof(MMapDnaTwoBitData)));
+}
+
+/* Split nibble-packed DNA into 2-bit bases and N and lower-case runs.  N
+ * bases are stored as A in the 2-bit array. */
+size_t MMapDnaTwoBit::write(MMapAlignment *alignment, const vector<char> &packedDna, hal_size_t sequenceLength) {
+    assert(packedDna.size() == (sequenceLength + 1) / 2);
+    vector<uint8_t> bases((sequenceLength + 3) / 4, 0);
+    vector<MMapDnaRun> nRuns, maskRuns;
+    for (hal_size_t i = 0; i < sequenceLength; i++) {
+        uint8_t packed = packedDna[i / 2];
+        uint8_t code = (i & 1) ? (packed & 0x0F) : (packed >> 4);
+        if ((code & ~NIBBLE_UPPER_BIT) == NIBBLE_N) {
+            addToRuns(nRuns, i);
+        } else {
+            bases[i / 4] |= (code & 0x3) << (6 - 2 * (i & 3));
+        }
+        if (not(code & NIBBLE_UPPER_BIT)) {
+            addToRuns(maskRuns, i);
+        }
+    }
+
+    MMapDnaTwoBitData header;
+    memset(&header, 0, sizeof(header));
+    header._sequenceLength = sequenceLength;
+    header._numNRuns = nRuns.size();
+    header._numMaskRuns = maskRuns.size();
+    size_t headerOffset = alignment->allocateNewArray(sizeof(MMapDnaTwoBitData));
+    header._basesOffset = alignment->allocateNewArray(bases.size());
+    if (not bases.empty()) {
+        memcpy(alignment->resolveOffset(header._basesOffset, bases.size()), bases.data(), bases.size());
+    }
+    header._nRunsOffset = writeRuns(alignment, nRuns);
+    header._maskRunsOffset = writeRuns(alignment, maskRuns);
+    *static_cast<MMapDnaTwoBitData *>(alignment->resolveOffset(headerOffset, sizeof(MMapDnaTwoBitData))) = header;
+    return headerOffset;
+}
+
+const MMapDnaRun *MMapDnaTwoBit::getRun(size_t runsOffset, hal_size_t runIndex) const {
+    return static_cast<const MMapDnaRun *>(
+        _alignment->resolveOffset(runsOffset + runIndex * sizeof(MMapDnaRun), sizeof(MMapDnaRun)));
+}
+
+/* index of the first run ending after position, or numRuns if none */
+hal_size_t MMapDnaTwoBit::findRun(size_t runsOffset, hal_size_t numRuns, hal_index_t position) const {
+    hal_size_t low = 0, high = numRuns;
+    while (low < high) {
+        hal_size_t mid = low + (high - low) / 2;
+        const MMapDnaRun *run = getRun(runsOffset, mid);
+        if (run->_start + hal_index_t(run->_length) <= position) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/* apply masks to the nibbles of runs overlapping start to end */
+void MMapDnaTwoBit::applyRuns(size_t runsOffset, hal_size_t numRuns, hal_index_t start, hal_index_t end, char *dest,
+                              uint8_t andMask, uint8_t orMask) const {
+    for (hal_size_t i = findRun(runsOffset, numRuns, start); i < numRuns; i++) {
+        const MMapDnaRun *run = getRun(runsOffset, i);
+        if (run->_start >= end) {
+            break;
+        }
+        updateNibbles(dest, max(run->_start, start) - start, min(run->_start + hal_index_t(run->_length), end) - start,
+                      andMask, orMask);
+    }
+}
+
+void MMapDnaTwoBit::decode(hal_index_t start, hal_index_t end, char *dest) const {
+    assert(((start & 1) == 0) && (start <= end) && (end <= hal_index_t(_header._sequenceLength)));
+    if (start == end) {
+        return;
+    }
+    const uint8_t *bases = static_cast<const uint8_t *>(
+        _alignment->resolveOffset(_header._basesOffset + start / 4, (end - 1) / 4 - start / 4 + 1));
+    for (hal_index_t i = start; i < end; i += 2) {
+        dest[(i - start) / 2] = decodeMap._map[bases[i / 4 - start / 4]][(i / 2) & 1];
+    }
+    // N keeps the case bit, which is then cleared for lower-case runs
+    applyRuns(_header._nRunsOffset, _header._numNRuns, start, end, dest, NIBBLE_UPPER_BIT, NIBBLE_N);
+    applyRuns(_header._maskRunsOffset, _header._numMaskRuns, start, end, dest, ~NIBBLE_UPPER_BIT & 0x0F, 0);
+}
+
+MMapDnaTwoBit::WindowPtr MMapDnaTwoBit::getWindow(hal_size_t windowIndex) const {
+    for (auto it = _cache.begin(); it != _cache.end(); ++it) {
+        if (it->first == windowIndex) {
+            _cache.splice(_cache.begin(), _cache, it);
+            return it->second;
+        }
+    }
+    // windows still referenced by a DnaAccess stay alive after eviction
+    hal_index_t start = windowIndex * MMAP_DNA_TWOBIT_WINDOW_SIZE;
+    hal_index_t end = std::min(start + MMAP_DNA_TWOBIT_WINDOW_SIZE, _header._sequenceLength);
+    WindowPtr window(new vector<char>((end - start + 1) / 2));
+    decode(start, end, window->data());
+    _cache.push_front(make_pair(windowIndex, window));
+    if (_cache.size() > MMAP_DNA_TWOBIT_CACHE_SIZE) {
+        _cache.pop_back();
+    }
+    return window;
+}
+
+void MMapDnaTwoBit::readAll(vector<char> &packedDna) const {
+    packedDna.resize((_header._sequenceLength + 1) / 2);
+    decode(0, _header._sequenceLength, packedDna.data());
+}
+
+void MMapDnaTwoBit::adviseAccess(hal_index_t start, hal_index_t end, AccessPattern pattern) const {
+    _alignment->adviseAccess(_header._basesOffset + start / 4, (end / 4) - (start / 4) + 1, pattern);
+}
@@ -0,0 +1,85 @@
+#ifndef _MMAPDNATWOBIT_H
+#define _MMAPDNATWOBIT_H
+#include "halAlignment.h"
+#include "halDefs.h"
+#include <list>
+#include <memory>
+#include <vector>
+
+namespace hal {
+    class MMapAlignment;
+
+    /* bases per window of 2-bit DNA decoded at a time, must be even */
+    static const hal_size_t MMAP_DNA_TWOBIT_WINDOW_SIZE = 4096;
+
+    /* number of decoded windows cached per genome */
+    static const size_t MMAP_DNA_TWOBIT_CACHE_SIZE = 16;
+
+    /* run of N or lower-case bases */
+    class MMapDnaRun {
+      public:
+        hal_index_t _start;
+        hal_size_t _length;
+    };
+
+    /* header of a genome's 2-bit DNA, added in mmap API 1.4 */
+    class MMapDnaTwoBitData {
+      public:
+        hal_size_t _sequenceLength; // number of bases
+        size_t _basesOffset;        // four bases per byte, first base in high bits
+        hal_size_t _numNRuns;       // number of runs of N
+        size_t _nRunsOffset;        // sorted MMapDnaRun array
+        hal_size_t _numMaskRuns;    // number of runs of lower-case bases
+        size_t _maskRunsOffset;     // sorted MMapDnaRun array
+        char _reserved[64];
+    };
+
+    /**
+     * DNA of a genome stored as in the UCSC 2bit format: two bits per base
+     * for A, C, G and T, with N and lower-case bases kept as sorted lists
+     * of runs, in genome coordinates.  Ranges are decoded to the nibble
+     * encoding used by DnaAccess, with recently decoded windows kept in an
+     * LRU cache.
+     */
+    class MMapDnaTwoBit {
+      public:
+        typedef std::shared_ptr<std::vector<char>> WindowPtr;
+
+        MMapDnaTwoBit(MMapAlignment *alignment, size_t offset);
+
+        /* encode nibble-packed DNA and write it to the file, returning the
+         * offset of the header */
+        static size_t write(MMapAlignment *alignment, const std::vector<char> &packedDna, hal_size_t sequenceLength);
+
+        hal_size_t getSequenceLength() const {
+            return _header._sequenceLength;
+        }
+
+        /* decode bases start to end (exclusive) to nibbles in dest, start
+         * must be even */
+        void decode(hal_index_t start, hal_index_t end, char *dest) const;
+
+        /* get the nibble-packed DNA of a window, decoding it if not cached */
+        WindowPtr getWindow(hal_size_t windowIndex) const;
+
+        /* decode all of the DNA into packedDna */
+        void readAll(std::vector<char> &packedDna) const;
+
+        /* pass an access pattern hint for bases start to end to the file */
+        void adviseAccess(hal_index_t start, hal_index_t end, AccessPattern pattern) const;
+
+      private:
+        const MMapDnaRun *getRun(size_t runsOffset, hal_size_t runIndex) const;
+        hal_size_t findRun(size_t runsOffset, hal_size_t numRuns, hal_index_t position) const;
+        void applyRuns(size_t runsOffset, hal_size_t numRuns, hal_index_t start, hal_index_t end, char *dest,
+                       uint8_t andMask, uint8_t orMask) const;
+
+        MMapAlignment *_alignment;
+        MMapDnaTwoBitData _header;
+        mutable std::list<std::pair<hal_size_t, WindowPtr>> _cache; // most recently used first
+    };
+}
+#endif
+// Local Variables:
+// mode: c++
+// End:
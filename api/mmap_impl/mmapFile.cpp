@@ -1,11 +1,16 @@
 #include "mmapFile.h"
 #include "halCommon.h"
+#include "mmapPrefetcher.h"
+#include <algorithm>
 #include <errno.h>
 #include <fcntl.h>
 #include <string.h>
+#include <sys/file.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <vector>
 #ifdef ENABLE_UDC
 extern "C" {
 #include "common.h"
@@ -16,6 +21,14 @@ extern "C" {
 /* constants for header */
 static const std::string FORMAT_NAME = "HAL-MMAP";
 
+/* Address space reserved when a file is opened for write access, so it can
+ * grow in place.  This is only virtual memory, no pages or swap are
+ * committed. */
+static const size_t MMAP_RESERVED_ADDRESS_SPACE = 4096 * GIGABYTE;
+
+/* size of reads when copying a file into memory */
+static const size_t MMAP_MEMORY_COPY_SIZE = 16 * 1024 * 1024;
+
 /* get current version as a string */
 static const std::string& getMmapApiVersion() {
     static std::string version;
@@ -111,6 +124,9 @@ void hal::MMapFile::createHeader() {
     strncpy(_header->mmapVersion, getMmapApiVersion().c_str(), sizeof(_header->mmapVersion) - 1);
     assert(HAL_VERSION.size() < sizeof(_header->halVersion));
     strncpy(_header->halVersion, HAL_VERSION.c_str(), sizeof(_header->halVersion) - 1);
+    _majorVersion = MMAP_API_MAJOR_VERSION;
+    _minorVersion = MMAP_API_MINOR_VERSION;
+    _version = getMmapApiVersion();
     _header->nextOffset = alignRound(sizeof(MMapHeader));
     _header->dirty = true;
     _header->nextOffset = _header->nextOffset;
@@ -126,23 +142,29 @@ namespace hal {
         virtual bool isUdcProtocol() const {
             return false;
         }
+        virtual void adviseAccess(size_t offset, size_t length, AccessPattern pattern) const;
+
+      protected:
+        virtual void growFile(size_t minSize);
 
       private:
         int openFile();
         void closeFile();
         void adjustFileSize(size_t size);
+        void *reserveAddressSpace();
         void *mapFile(void *requiredAddr = NULL);
         void unmapFile();
         void openRead();
         void openWrite(size_t fileSize);
 
-        int _fd; // open file descriptor
+        int _fd;              // open file descriptor
+        size_t _reservedSize; // size of address range at _basePtr
     };
 }
 
 /* Constructor. Open or create the specified file. */
 hal::MMapFileLocal::MMapFileLocal(const std::string &alignmentPath, unsigned mode, size_t fileSize)
-    : MMapFile(alignmentPath, mode, false), _fd(-1) {
+    : MMapFile(alignmentPath, mode, false), _fd(-1), _reservedSize(0) {
     if (_mode & WRITE_ACCESS) {
         openWrite(fileSize);
     } else {
@@ -194,9 +216,23 @@ void hal::MMapFileLocal::adjustFileSize(size_t size) {
     _fileSize = size;
 }
 
+/* Reserve an inaccessible address range that the file is mapped at the start
+ * of, so that it can later be extended in place.  If the reservation fails
+ * (e.g. address space limit), NULL is returned and the file will not be able
+ * to grow. */
+void *hal::MMapFileLocal::reserveAddressSpace() {
+    _reservedSize = std::max(_fileSize, MMAP_RESERVED_ADDRESS_SPACE);
+    void *ptr = mmap(NULL, _reservedSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (ptr == MAP_FAILED) {
+        _reservedSize = _fileSize;
+        return NULL;
+    }
+    return ptr;
+}
+
 /* map file into memory */
 void *hal::MMapFileLocal::mapFile(void *requiredAddr) {
-    assert(_basePtr == NULL);
+    assert((_basePtr == NULL) || (requiredAddr == _basePtr));
     unsigned prot = PROT_READ | ((_mode & WRITE_ACCESS) ? PROT_WRITE : 0);
     int flags = MAP_SHARED | MAP_FILE;
     if (requiredAddr != NULL) {
@@ -219,7 +255,7 @@ void *hal::MMapFileLocal::mapFile(void *requiredAddr) {
 /* unmap file, if mapped */
 void hal::MMapFileLocal::unmapFile() {
     if (_basePtr != NULL) {
-        if (::munmap(const_cast<void *>(_basePtr), _fileSize) < 0) {
+        if (::munmap(const_cast<void *>(_basePtr), _reservedSize) < 0) {
             throw hal_errno_exception(_alignmentPath, "munmap failed", errno);
         }
         _basePtr = NULL;
@@ -230,7 +266,14 @@ void hal::MMapFileLocal::unmapFile() {
 void hal::MMapFileLocal::openRead() {
     _fd = openFile();
     _fileSize = getFileStatSize(_fd);
+    _reservedSize = _fileSize;
     _basePtr = mapFile();
+#ifdef MADV_HUGEPAGE
+    // Let the kernel back a read-only mapping with huge pages where the
+    // file system supports it, reducing TLB misses on large files.  This is
+    // only a hint, so errors are ignored.
+    madvise(_basePtr, _fileSize, MADV_HUGEPAGE);
+#endif
     loadHeader(false);
 }
 
@@ -239,11 +282,11 @@ void hal::MMapFileLocal::openWrite(size_t fileSize) {
     _fd = openFile();
     if (_mode & CREATE_ACCESS) {
         adjustFileSize(0); // clear out existing data
-        adjustFileSize(fileSize);
+        adjustFileSize(std::max(fileSize, alignRound(sizeof(MMapHeader)))); // grows on demand
     } else if (_mode & WRITE_ACCESS) {
         adjustFileSize(getFileStatSize(_fd) + fileSize);
     }
-    _basePtr = mapFile();
+    _basePtr = mapFile(reserveAddressSpace());
     if (_mode & CREATE_ACCESS) {
         createHeader();
     } else {
@@ -251,6 +294,45 @@ void hal::MMapFileLocal::openWrite(size_t fileSize) {
     }
 }
 
+/* Extend the file, at least doubling it, and map the new size over the
+ * reserved address range.  The base address doesn't change. */
+void hal::MMapFileLocal::growFile(size_t minSize) {
+    size_t newSize = std::min(std::max(minSize, 2 * _fileSize), _reservedSize);
+    if (newSize < minSize) {
+        throw hal_exception(_alignmentPath + ": mmap file is full, unable to grow beyond " + std::to_string(_reservedSize) +
+                            " bytes, specify a larger initial file size");
+    }
+    adjustFileSize(newSize);
+    mapFile(_basePtr);
+}
+
+/* Translate an access pattern for a range of the file to madvise() advice.
+ * The range is extended to page boundaries and clipped to the file.  Errors
+ * are ignored, as this is only a hint. */
+void hal::MMapFileLocal::adviseAccess(size_t offset, size_t length, AccessPattern pattern) const {
+    if ((_basePtr == NULL) || (offset >= _fileSize)) {
+        return;
+    }
+    size_t end = offset + std::min(length, _fileSize - offset);
+    size_t start = offset - (offset % sysconf(_SC_PAGESIZE));
+    int advice = MADV_NORMAL;
+    switch (pattern) {
+    case ACCESS_NORMAL:
+        advice = MADV_NORMAL;
+        break;
+    case ACCESS_SEQUENTIAL:
+        advice = MADV_SEQUENTIAL;
+        break;
+    case ACCESS_RANDOM:
+        advice = MADV_RANDOM;
+        break;
+    case ACCESS_WILLNEED:
+        advice = MADV_WILLNEED;
+        break;
+    }
+    madvise(static_cast<char *>(_basePtr) + start, end - start, advice);
+}
+
 /* close the file if open */
 void hal::MMapFileLocal::closeFile() {
     if (_fd >= 0) {
@@ -261,9 +343,169 @@ void hal::MMapFileLocal::closeFile() {
     }
 }
 
+namespace hal {
+    /* Class that implements MMapFile as a read-only copy of a local file
+     * in memory, either private to the process or in a shared memory
+     * object that is reused by other processes opening the same file. */
+    class MMapFileMemory : public MMapFile {
+      public:
+        MMapFileMemory(const std::string &alignmentPath, unsigned mode, bool shared);
+        virtual void close();
+        virtual ~MMapFileMemory();
+        virtual bool isUdcProtocol() const {
+            return false;
+        }
+
+      private:
+        void loadPrivate(int fd);
+        void loadShared(int fd, const struct stat &fileStat);
+        void copyFile(int fd, int destFd, char *dest);
+        void adviseHugePages();
+        void unmapMemory();
+    };
+}
+
+/* Constructor.  Copy the file to memory, it is not kept open. */
+hal::MMapFileMemory::MMapFileMemory(const std::string &alignmentPath, unsigned mode, bool shared)
+    : MMapFile(alignmentPath, mode, false) {
+    if (_mode & WRITE_ACCESS) {
+        throw hal_exception("in-memory mmap HAL files are read-only: " + alignmentPath);
+    }
+    int fd = ::open(_alignmentPath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw hal_errno_exception(_alignmentPath, "open failed", errno);
+    }
+    try {
+        struct stat fileStat;
+        if (::fstat(fd, &fileStat) < 0) {
+            throw hal_errno_exception(_alignmentPath, "stat failed", errno);
+        }
+        _fileSize = fileStat.st_size;
+        if (_fileSize < sizeof(MMapHeader)) {
+            throw hal_exception(_alignmentPath + ": file size of " + std::to_string(_fileSize) +
+                                " is less that header size of " + std::to_string(sizeof(MMapHeader)));
+        }
+        if (shared) {
+            loadShared(fd, fileStat);
+        } else {
+            loadPrivate(fd);
+        }
+    } catch (...) {
+        ::close(fd);
+        unmapMemory();
+        throw;
+    }
+    ::close(fd);
+    loadHeader(false);
+}
+
+void hal::MMapFileMemory::close() {
+    if (_basePtr == NULL) {
+        throw hal_exception(_alignmentPath + ": MMapFile::close() called on closed file");
+    }
+    unmapMemory();
+}
+
+hal::MMapFileMemory::~MMapFileMemory() {
+    unmapMemory();
+}
+
+/* Copy the file from fd to destFd if it is open, otherwise to dest. */
+void hal::MMapFileMemory::copyFile(int fd, int destFd, char *dest) {
+    std::vector<char> buffer((destFd >= 0) ? MMAP_MEMORY_COPY_SIZE : 0);
+    for (size_t offset = 0; offset < _fileSize;) {
+        char *readPtr = (destFd >= 0) ? buffer.data() : dest + offset;
+        ssize_t count = ::pread(fd, readPtr, std::min(MMAP_MEMORY_COPY_SIZE, _fileSize - offset), offset);
+        if (count <= 0) {
+            throw hal_errno_exception(_alignmentPath, "read failed", (count < 0) ? errno : EIO);
+        }
+        if ((destFd >= 0) && (::pwrite(destFd, readPtr, count, offset) != count)) {
+            throw hal_errno_exception(_alignmentPath, "write to shared memory failed", errno);
+        }
+        offset += count;
+    }
+}
+
+/* Ask for huge pages to cut page faults and TLB misses.  Anonymous memory
+ * honours this with transparent huge pages enabled, shared memory only if
+ * they are also enabled for shmem.  This is a hint, so errors are
+ * ignored. */
+void hal::MMapFileMemory::adviseHugePages() {
+#ifdef MADV_HUGEPAGE
+    madvise(_basePtr, _fileSize, MADV_HUGEPAGE);
+#endif
+}
+
+/* copy the file to anonymous memory, which is made read-only once loaded */
+void hal::MMapFileMemory::loadPrivate(int fd) {
+    void *ptr = mmap(NULL, _fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        throw hal_errno_exception(_alignmentPath, "allocating memory for file failed", errno);
+    }
+    _basePtr = ptr;
+    adviseHugePages();
+    copyFile(fd, -1, static_cast<char *>(_basePtr));
+    mprotect(_basePtr, _fileSize, PROT_READ);
+}
+
+/* Map a shared memory object holding a copy of the file, loading it if this
+ * is the first process to open this version of the file.  The object is
+ * named by the file's device, inode, size and modification time, and
+ * remains until removed from /dev/shm or the system restarts.  An exclusive
+ * lock is held while checking and loading, so a partial copy left by an
+ * interrupted load is replaced. */
+void hal::MMapFileMemory::loadShared(int fd, const struct stat &fileStat) {
+    std::string shmName = "/hal-mmap-" + std::to_string(fileStat.st_dev) + "-" + std::to_string(fileStat.st_ino) + "-" +
+                          std::to_string(fileStat.st_size) + "-" + std::to_string(fileStat.st_mtime);
+    int shmFd = shm_open(shmName.c_str(), O_RDWR | O_CREAT, 0644);
+    if ((shmFd < 0) && (errno == EACCES)) {
+        // created by another user, can only be used if already loaded
+        shmFd = shm_open(shmName.c_str(), O_RDONLY, 0);
+    }
+    if (shmFd < 0) {
+        throw hal_errno_exception(_alignmentPath, "opening shared memory " + shmName + " failed", errno);
+    }
+    try {
+        if (flock(shmFd, LOCK_EX) < 0) {
+            throw hal_errno_exception(_alignmentPath, "locking shared memory " + shmName + " failed", errno);
+        }
+        if (getFileStatSize(shmFd) != _fileSize) {
+            if (ftruncate(shmFd, 0) < 0) {
+                throw hal_errno_exception(_alignmentPath, "clearing shared memory " + shmName + " failed", errno);
+            }
+            copyFile(fd, shmFd, NULL);
+        }
+        // pages are resident, so only pages that are touched take a (minor)
+        // fault, which keeps opening cheap for short-lived processes
+        void *ptr = mmap(NULL, _fileSize, PROT_READ, MAP_SHARED, shmFd, 0);
+        if (ptr == MAP_FAILED) {
+            throw hal_errno_exception(_alignmentPath, "mmap of shared memory " + shmName + " failed", errno);
+        }
+        _basePtr = ptr;
+        adviseHugePages();
+    } catch (...) {
+        ::close(shmFd); // also releases lock
+        throw;
+    }
+    ::close(shmFd);
+}
+
+/* unmap memory, if mapped */
+void hal::MMapFileMemory::unmapMemory() {
+    if (_basePtr != NULL) {
+        if (::munmap(_basePtr, _fileSize) < 0) {
+            throw hal_errno_exception(_alignmentPath, "munmap failed", errno);
+        }
+        _basePtr = NULL;
+    }
+}
+
 #ifdef ENABLE_UDC
 namespace hal {
-    /* Class that implements UDC file version of MMapFile */
+    /* Class that implements UDC file version of MMapFile.  Fetches go
+     * through an MMapPrefetcher, which skips blocks already fetched,
+     * merges adjacent missing blocks and reads ahead of sequential access
+     * in a thread using a second UDC handle on the same cache. */
     class MMapFileUdc : public MMapFile {
       public:
         MMapFileUdc(const std::string &alignmentPath, unsigned mode, size_t fileSize);
@@ -277,42 +519,67 @@ namespace hal {
         virtual void fetch(size_t offset, size_t accessSize) const;
 
       private:
+        struct udc2File *openUdc();
+        void closeUdc();
+
         struct udc2File *_udcFile;
+        struct udc2File *_prefetchUdcFile; // only used by the read-ahead thread
+        MMapPrefetcher *_prefetcher;
     };
 }
 
 /* Constructor. Open or create the specified file. */
 hal::MMapFileUdc::MMapFileUdc(const std::string &alignmentPath, unsigned mode, size_t fileSize)
-    : MMapFile(alignmentPath, mode, true), _udcFile(NULL) {
+    : MMapFile(alignmentPath, mode, true), _udcFile(NULL), _prefetchUdcFile(NULL), _prefetcher(NULL) {
     if (_mode & WRITE_ACCESS) {
         throw hal_exception("write access not supported for UDC:" + alignmentPath);
     }
-    _udcFile = udc2FileMayOpen(const_cast<char *>(alignmentPath.c_str()), NULL, UDC_BLOCK_SIZE);
-    if (_udcFile == NULL) {
-        throw hal_exception("can't open " + alignmentPath);
-    }
-    udc2MMap(_udcFile);
+    _udcFile = openUdc();
+    _prefetchUdcFile = openUdc();
 
-    // get base point and fetch header
+    // get base point and size, then fetch header through the prefetcher
     _basePtr = udc2MMapFetch(_udcFile, 0, sizeof(MMapHeader));
     _fileSize = udc2SizeFromCache(const_cast<char *>(_alignmentPath.c_str()), NULL);
+    _prefetcher = new MMapPrefetcher(
+        _fileSize, UDC_BLOCK_SIZE, [this](size_t offset, size_t length) { udc2MMapFetch(_udcFile, offset, length); },
+        [this](size_t offset, size_t length) { udc2MMapFetch(_prefetchUdcFile, offset, length); });
     loadHeader(false);
 }
 
+/* open a UDC handle on the file and enable mmap access */
+struct udc2File *hal::MMapFileUdc::openUdc() {
+    struct udc2File *udcFile = udc2FileMayOpen(const_cast<char *>(_alignmentPath.c_str()), NULL, UDC_BLOCK_SIZE);
+    if (udcFile == NULL) {
+        throw hal_exception("can't open " + _alignmentPath);
+    }
+    udc2MMap(udcFile);
+    return udcFile;
+}
+
+/* stop read-ahead, then close UDC handles */
+void hal::MMapFileUdc::closeUdc() {
+    delete _prefetcher;
+    _prefetcher = NULL;
+    if (_prefetchUdcFile != NULL) {
+        udc2FileClose(&_prefetchUdcFile);
+    }
+    if (_udcFile != NULL) {
+        udc2FileClose(&_udcFile);
+    }
+}
+
 /* close file, marking as clean.  Don't  */
 void hal::MMapFileUdc::close() {
     if (_basePtr == NULL) {
         throw hal_exception(_alignmentPath + ": MMapFile::close() called on closed file");
     }
-    udc2FileClose(&_udcFile);
+    closeUdc();
 }
 
 /* Destructor. write fields to header and close.  If write access and close
  * has not been called, file will me left mark dirty */
 hal::MMapFileUdc::~MMapFileUdc() {
-    if (_udcFile != NULL) {
-        udc2FileClose(&_udcFile);
-    }
+    closeUdc();
 }
 
 /* fetch into UDC cache */
@@ -321,15 +588,20 @@ void hal::MMapFileUdc::fetch(size_t offset, size_t accessSize) const {
         // FIXME  - length off end, iterator does this
         accessSize = _fileSize - offset;
     }
-
-    udc2MMapFetch(_udcFile, offset, accessSize);
+    _prefetcher->fetch(offset, accessSize);
 }
 
 #endif
 
 /** create a MMapFile object, opening a local file */
-hal::MMapFile *hal::MMapFile::factory(const std::string &alignmentPath, unsigned mode, size_t fileSize) {
-    if (isUrl(alignmentPath)) {
+hal::MMapFile *hal::MMapFile::factory(const std::string &alignmentPath, unsigned mode, size_t fileSize,
+                                      MMapMemoryMode memoryMode) {
+    if (memoryMode != MMAP_MEMORY_MAPPED) {
+        if (isUrl(alignmentPath)) {
+            throw hal_exception("loading into memory is not supported with URL: " + alignmentPath);
+        }
+        return new MMapFileMemory(alignmentPath, mode, memoryMode == MMAP_MEMORY_SHARED);
+    } else if (isUrl(alignmentPath)) {
         if (mode & (CREATE_ACCESS | WRITE_ACCESS)) {
             throw hal_exception("create or write access not support with URL: " + alignmentPath);
         }
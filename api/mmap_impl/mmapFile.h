@@ -10,7 +10,7 @@
 namespace hal {
     /* Current API major and minor versions */
     static const unsigned MMAP_API_MAJOR_VERSION = 1;
-    static const unsigned MMAP_API_MINOR_VERSION = 1;
+    static const unsigned MMAP_API_MINOR_VERSION = 6;
 
     /* get current mmap version as a string */
     const std::string& getMmapCurentVersion();
@@ -19,6 +19,13 @@ namespace hal {
      * a offset to it */
     static const size_t MMAP_NULL_OFFSET = 0;
 
+    /* how a file opened for read access is placed in memory */
+    enum MMapMemoryMode {
+        MMAP_MEMORY_MAPPED,  // map the file, paging it in on demand
+        MMAP_MEMORY_PRIVATE, // copy the file to huge-page backed memory private to the process
+        MMAP_MEMORY_SHARED   // copy the file to shared memory, reused by all processes opening it
+    };
+
     /* header for the file */
     struct MMapHeader {
         char format[32];
@@ -64,6 +71,11 @@ namespace hal {
 
         virtual bool isUdcProtocol() const = 0;
 
+        /* pass a hint on how a range of the file will be accessed to the
+         * OS, no-op by default */
+        virtual void adviseAccess(size_t offset, size_t length, AccessPattern pattern) const {
+        }
+
         inline size_t getRootOffset() const;
         inline void *toPtr(size_t offset, size_t accessSize);
         inline const void *toPtr(size_t offset, size_t accessSize) const;
@@ -88,6 +100,11 @@ namespace hal {
         virtual void fetch(size_t offset, size_t accessSize) const {
             // no-op by default
         }
+        /* extend the file so that at least minSize bytes are mapped, keeping
+         * _basePtr unchanged.  Error by default. */
+        virtual void growFile(size_t minSize) {
+            throw hal_exception("mmap file is full, specify file size larger than " + std::to_string(_fileSize));
+        }
 
         void setHeaderPtr();
         void createHeader();
@@ -109,7 +126,7 @@ namespace hal {
         void parseCheckVersion();
 
         static MMapFile *factory(const std::string &alignmentPath, unsigned mode = READ_ACCESS,
-                                 size_t fileSize = MMAP_DEFAULT_FILE_SIZE);
+                                 size_t fileSize = MMAP_DEFAULT_FILE_SIZE, MMapMemoryMode memoryMode = MMAP_MEMORY_MAPPED);
 
         std::string _version;
         unsigned _majorVersion;
@@ -146,11 +163,12 @@ const void *hal::MMapFile::toPtr(size_t offset, size_t accessSize) const {
 }
 
 /** Allocate new memory, resize file if necessary. If isRoot is specified, it
- * is stored as the root used to find all object.  */
+ * is stored as the root used to find all object.  Growing the file never moves
+ * the mapping, so pointers obtained from toPtr() remain valid. */
 size_t hal::MMapFile::allocMem(size_t size, bool isRoot) {
     validateWriteAccess();
     if (_header->nextOffset + size > _fileSize) {
-        throw hal_exception("mmap file is full, specify file size larger than " + std::to_string(_fileSize));
+        growFile(_header->nextOffset + size);
     }
     size_t offset = _header->nextOffset;
     _header->nextOffset += alignRound(size);
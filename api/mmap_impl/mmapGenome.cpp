@@ -16,6 +16,8 @@ using namespace std;
 
 MMapGenome::~MMapGenome() {
     deleteSequenceCache();
+    delete _dnaBlocks;
+    delete _dnaTwoBit;
 }
 
 void MMapGenome::setDimensions(const vector<Sequence::Info> &sequenceDimensions, bool storeDNAArrays) {
@@ -40,7 +42,18 @@ void MMapGenome::setDimensions(const vector<Sequence::Info> &sequenceDimensions,
     // Write the new DNA/sequence information, allocating one base per nibble
     hal_size_t dnaLength = (totalSequenceLength + 1) / 2;
     _data->_totalSequenceLength = totalSequenceLength;
-    _data->_dnaOffset = _alignment->allocateNewArray(dnaLength);
+    if (isDnaBuffered()) {
+        // kept in memory until the alignment is closed
+        delete _dnaBlocks;
+        _dnaBlocks = NULL;
+        delete _dnaTwoBit;
+        _dnaTwoBit = NULL;
+        _dnaBuffer.assign(dnaLength, 0);
+        _dnaBufferDirty = true;
+        _data->_dnaOffset = MMAP_NULL_OFFSET;
+    } else {
+        _data->_dnaOffset = _alignment->allocateNewArray(dnaLength);
+    }
     // Reverse space for the sequence data (plus an extra at the end
     // to indicate the end position of the sequence iterator).  FIXME: extra no longer needed
     _data->_sequencesOffset = _alignment->allocateNewArray(sizeof(MMapSequenceData) * sequenceDimensions.size() + 1);
@@ -138,7 +151,7 @@ void MMapGenome::updateTopDimensions(const vector<Sequence::UpdateInfo> &updated
     }
     _data->_numTopSegments = numTopSegments;
 
-    _data->_topSegmentsOffset = _alignment->allocateNewArray((_data->_numTopSegments + 1) * sizeof(MMapTopSegmentData));
+    _data->_topSegmentsOffset = _topSegments.create(_data->_numTopSegments, _data->_totalSequenceLength);
     hal_index_t topSegmentStartIndex = 0;
     for (size_t i = 0; i < topDimensions.size(); i++) {
         MMapSequence seq(this, getSequenceData(i));
@@ -157,7 +170,7 @@ void MMapGenome::updateBottomDimensions(const vector<Sequence::UpdateInfo> &upda
     }
     _data->_numBottomSegments = numBottomSegments;
     _data->_bottomSegmentsOffset =
-        _alignment->allocateNewArray((_data->_numBottomSegments + 1) * MMapBottomSegmentData::getSize(this));
+        _bottomSegments.create(_data->_numBottomSegments, getNumChildren(), _data->_totalSequenceLength);
     hal_index_t bottomSegmentStartIndex = 0;
     for (size_t i = 0; i < bottomDimensions.size(); i++) {
         MMapSequence seq(this, getSequenceData(i));
@@ -365,6 +378,192 @@ void MMapGenome::rename(const std::string &name) {
     _data->setName(_alignment, name);
 }
 
+/* index of the last of numSegments segments starting at or before position */
+template <class SegmentType>
+static hal_index_t findSegmentIndex(MMapGenome *genome, hal_size_t numSegments, hal_index_t position) {
+    SegmentType segment(genome, 0);
+    hal_index_t low = 0, high = numSegments - 1;
+    while (low < high) {
+        hal_index_t mid = low + (high - low + 1) / 2;
+        segment.setArrayIndex(genome, mid);
+        if (segment.getStartPosition() <= position) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+/* Advise on the DNA and the top and bottom segments overlapping the range.
+ * Ranges outside of the genome are ignored, as this is only a hint. */
+void MMapGenome::setAccessPattern(AccessPattern pattern, hal_index_t start, hal_size_t length) const {
+    hal_size_t sequenceLength = getSequenceLength();
+    if ((start < 0) || (hal_size_t(start) >= sequenceLength)) {
+        return;
+    }
+    if ((length == 0) || (length > sequenceLength - start)) {
+        length = sequenceLength - start;
+    }
+    hal_index_t end = start + length - 1;
+    if (_data->_dnaOffset == MMAP_NULL_OFFSET) {
+        // no DNA in file yet
+    } else if (isDnaCompressed()) {
+        getDnaBlocks()->adviseAccess(start, end, pattern);
+    } else if (isDnaTwoBit()) {
+        getDnaTwoBit()->adviseAccess(start, end, pattern);
+    } else {
+        // two bases per byte
+        _alignment->adviseAccess(_data->_dnaOffset + start / 2, (end / 2) - (start / 2) + 1, pattern);
+    }
+    MMapGenome *genome = const_cast<MMapGenome *>(this);
+    if (getNumTopSegments() > 0) {
+        _topSegments.adviseAccess(findSegmentIndex<MMapTopSegment>(genome, getNumTopSegments(), start),
+                                  findSegmentIndex<MMapTopSegment>(genome, getNumTopSegments(), end), pattern);
+    }
+    if (getNumBottomSegments() > 0) {
+        _bottomSegments.adviseAccess(findSegmentIndex<MMapBottomSegment>(genome, getNumBottomSegments(), start),
+                                     findSegmentIndex<MMapBottomSegment>(genome, getNumBottomSegments(), end), pattern);
+    }
+}
+
+bool MMapGenome::getSegmentIndexRange(bool top, hal_index_t position, hal_index_t &first, hal_index_t &last) const {
+    if (top) {
+        return _topSegments.getSiteIndexRange(position, getNumTopSegments(), first, last);
+    } else {
+        return _bottomSegments.getSiteIndexRange(position, getNumBottomSegments(), first, last);
+    }
+}
+
+/* Column-wise arrays are copied field by field without creating segment
+ * objects; the struct layout of older files goes through the iterators. */
+void MMapGenome::getSegmentBlock(bool top, hal_index_t first, hal_size_t count, SegmentBlock &block) const {
+    if ((first < 0) || (first + count > (top ? getNumTopSegments() : getNumBottomSegments()))) {
+        throw hal_exception("segment block out of range in genome " + _name);
+    }
+    if (not _topSegments.isColumnar()) {
+        Genome::getSegmentBlock(top, first, count, block);
+    } else if (top) {
+        block.resize(first, count, true, 1);
+        for (hal_size_t i = 0; i < count; ++i) {
+            block._startPositions[i] = _topSegments.getStartPosition(first + i);
+            block._parseIndexes[i] = _topSegments.getBottomParseIndex(first + i);
+            block._linkIndexes[i] = _topSegments.getParentIndex(first + i);
+            block._paralogyIndexes[i] = _topSegments.getNextParalogyIndex(first + i);
+            block._reversed[i] = _topSegments.getReversed(first + i);
+        }
+        block._startPositions[count] = _topSegments.getStartPosition(first + count);
+    } else {
+        hal_size_t numChildren = getNumChildren();
+        block.resize(first, count, false, numChildren);
+        for (hal_size_t i = 0; i < count; ++i) {
+            block._startPositions[i] = _bottomSegments.getStartPosition(first + i);
+            block._parseIndexes[i] = _bottomSegments.getTopParseIndex(first + i);
+            for (hal_size_t child = 0; child < numChildren; ++child) {
+                block._linkIndexes[i * numChildren + child] = _bottomSegments.getChildIndex(first + i, child);
+                block._reversed[i * numChildren + child] = _bottomSegments.getChildReversed(first + i, child);
+            }
+        }
+        block._startPositions[count] = _bottomSegments.getStartPosition(first + count);
+    }
+}
+
+void MMapGenome::setSegmentBlock(bool top, const SegmentBlock &block) {
+    hal_size_t count = block.getNumSegments();
+    hal_index_t first = block._first;
+    if ((first < 0) || (first + count > (top ? getNumTopSegments() : getNumBottomSegments())) ||
+        (block._startPositions[count] > (hal_index_t)getSequenceLength())) {
+        throw hal_exception("segment block out of range in genome " + _name);
+    }
+    if ((not top) && (block._numChildren != getNumChildren())) {
+        throw hal_exception("segment block has wrong number of children for genome " + _name);
+    }
+    if (not _topSegments.isColumnar()) {
+        Genome::setSegmentBlock(top, block);
+    } else if (top) {
+        for (hal_size_t i = 0; i < count; ++i) {
+            _topSegments.setStartPosition(first + i, block._startPositions[i]);
+            _topSegments.setBottomParseIndex(first + i, block._parseIndexes[i]);
+            _topSegments.setParentIndex(first + i, block._linkIndexes[i]);
+            _topSegments.setNextParalogyIndex(first + i, block._paralogyIndexes[i]);
+            _topSegments.setReversed(first + i, block._reversed[i]);
+        }
+        _topSegments.setStartPosition(first + count, block._startPositions[count]);
+    } else {
+        hal_size_t numChildren = block._numChildren;
+        for (hal_size_t i = 0; i < count; ++i) {
+            _bottomSegments.setStartPosition(first + i, block._startPositions[i]);
+            _bottomSegments.setTopParseIndex(first + i, block._parseIndexes[i]);
+            for (hal_size_t child = 0; child < numChildren; ++child) {
+                _bottomSegments.setChildIndex(first + i, child, block._linkIndexes[i * numChildren + child]);
+                _bottomSegments.setChildReversed(first + i, child, block._reversed[i * numChildren + child]);
+            }
+        }
+        _bottomSegments.setStartPosition(first + count, block._startPositions[count]);
+    }
+}
+
+void MMapGenome::writeSiteIndexes() {
+    _topSegments.writeSiteIndex(getNumTopSegments());
+    _bottomSegments.writeSiteIndex(getNumBottomSegments());
+}
+
+/* reader of compressed DNA, opened on first use */
+const MMapDnaBlocks *MMapGenome::getDnaBlocks() const {
+    assert(isDnaCompressed() && (_data->_dnaOffset != MMAP_NULL_OFFSET));
+    if (_dnaBlocks == NULL) {
+        _dnaBlocks = new MMapDnaBlocks(_alignment, _data->_dnaOffset);
+    }
+    return _dnaBlocks;
+}
+
+/* reader of 2-bit DNA, opened on first use */
+const MMapDnaTwoBit *MMapGenome::getDnaTwoBit() const {
+    assert(isDnaTwoBit() && (_data->_dnaOffset != MMAP_NULL_OFFSET));
+    if (_dnaTwoBit == NULL) {
+        _dnaTwoBit = new MMapDnaTwoBit(_alignment, _data->_dnaOffset);
+    }
+    return _dnaTwoBit;
+}
+
+/* Get the packed DNA of a compressed or 2-bit genome for update, decoding
+ * it into memory on first use.  It is written when the alignment is closed. */
+vector<char> &MMapGenome::getDnaBuffer() {
+    assert(isDnaBuffered());
+    if (_dnaBuffer.empty() && (_data->_dnaOffset != MMAP_NULL_OFFSET)) {
+        if (isDnaCompressed()) {
+            getDnaBlocks()->readAll(_dnaBuffer);
+        } else {
+            getDnaTwoBit()->readAll(_dnaBuffer);
+        }
+    }
+    return _dnaBuffer;
+}
+
+/* Encode and write DNA buffered in memory if modified.  The space used by
+ * the previous version of the DNA is not reclaimed. */
+void MMapGenome::writeDnaBuffer() {
+    if (_dnaBufferDirty) {
+        if (isDnaCompressed()) {
+            _data->_dnaOffset = MMapDnaBlocks::write(_alignment, _dnaBuffer, getSequenceLength(), _alignment->getDnaBlockSize());
+        } else {
+            _data->_dnaOffset = MMapDnaTwoBit::write(_alignment, _dnaBuffer, getSequenceLength());
+        }
+        delete _dnaBlocks;
+        _dnaBlocks = NULL;
+        delete _dnaTwoBit;
+        _dnaTwoBit = NULL;
+        _dnaBufferDirty = false;
+    }
+}
+
+/* Write DNA buffered in memory and free the buffer, which must not be in
+ * use by a DnaAccess.  It is decoded again if needed. */
+void MMapGenome::releaseDnaBuffer() {
+    writeDnaBuffer();
+    vector<char>().swap(_dnaBuffer);
+}
+
 void MMapGenome::deleteSequenceCache() {
     for (auto seq : _sequenceObjCache) {
         delete seq;
@@ -2,12 +2,13 @@
 #define _MMAPGENOME_H
 #include "halGenome.h"
 #include "mmapAlignment.h"
-#include "mmapBottomSegmentData.h"
+#include "mmapDnaBlocks.h"
+#include "mmapDnaTwoBit.h"
 #include "mmapGenomeSiteMap.h"
 #include "mmapMetaData.h"
 #include "mmapPerfectHashTable.h"
+#include "mmapSegmentArray.h"
 #include "mmapString.h"
-#include "mmapTopSegmentData.h"
 #include <map>
 
 namespace hal {
@@ -24,8 +25,6 @@ namespace hal {
         std::string getName(MMapAlignment *alignment) const;
         void setName(MMapAlignment *alignment, const std::string &name);
         void initializeName(MMapAlignment *alignment, const std::string &name);
-        MMapTopSegmentData *getTopSegmentData(MMapAlignment *alignment, hal_index_t index);
-        MMapBottomSegmentData *getBottomSegmentData(MMapAlignment *alignment, MMapGenome *genome, hal_index_t index);
 
       private:
         hal_size_t _totalSequenceLength;
@@ -51,13 +50,17 @@ namespace hal {
             : Genome(alignment, data->getName(alignment)), _alignment(alignment), _data(data), _arrayIndex(arrayIndex),
               _name(data->getName(_alignment)), _metaData(_alignment, _data->_metadataOffset),
               _sequenceNameHash(alignment->getMMapFile(), data->_sequenceHashOffset),
-              _genomeSiteMap(alignment->getMMapFile(), data->_genomeSiteMapOffset) {
+              _genomeSiteMap(alignment->getMMapFile(), data->_genomeSiteMapOffset),
+              _topSegments(alignment, data->_topSegmentsOffset), _bottomSegments(alignment, this, data->_bottomSegmentsOffset),
+              _dnaBufferDirty(false), _dnaBlocks(NULL), _dnaTwoBit(NULL) {
             _sequenceObjCache.resize(data->_numSequences);
         };
         MMapGenome(MMapAlignment *alignment, MMapGenomeData *data, size_t arrayIndex, const std::string &name)
             : Genome(alignment, name), _alignment(alignment), _data(data), _arrayIndex(arrayIndex), _name(name),
               _metaData(_alignment), _sequenceNameHash(alignment->getMMapFile(), data->_sequenceHashOffset),
-              _genomeSiteMap(alignment->getMMapFile(), data->_genomeSiteMapOffset) {
+              _genomeSiteMap(alignment->getMMapFile(), data->_genomeSiteMapOffset),
+              _topSegments(alignment, data->_topSegmentsOffset), _bottomSegments(alignment, this, data->_bottomSegmentsOffset),
+              _dnaBufferDirty(false), _dnaBlocks(NULL), _dnaTwoBit(NULL) {
             _data->initializeName(_alignment, _name);
             _data->_metadataOffset = _metaData.getOffset();
             _sequenceObjCache.resize(data->_numSequences);
@@ -65,11 +68,11 @@ namespace hal {
 
         virtual ~MMapGenome();
 
-        MMapTopSegmentData *getTopSegmentPointer(hal_index_t index) {
-            return _data->getTopSegmentData(_alignment, index);
+        MMapTopSegmentArray *getTopSegmentArray() {
+            return &_topSegments;
         };
-        MMapBottomSegmentData *getBottomSegmentPointer(hal_index_t index) {
-            return _data->getBottomSegmentData(_alignment, this, index);
+        MMapBottomSegmentArray *getBottomSegmentArray() {
+            return &_bottomSegments;
         };
 
         void updateGenomeArrayBasePtr(MMapGenomeData *base) {
@@ -118,6 +121,17 @@ namespace hal {
 
         void rename(const std::string &newName);
 
+        void setAccessPattern(AccessPattern pattern, hal_index_t start = 0, hal_size_t length = 0) const;
+
+        bool getSegmentIndexRange(bool top, hal_index_t position, hal_index_t &first, hal_index_t &last) const;
+
+        void getSegmentBlock(bool top, hal_index_t first, hal_size_t count, SegmentBlock &block) const;
+
+        void setSegmentBlock(bool top, const SegmentBlock &block);
+
+        /* store sampled site indexes of the segment arrays if missing */
+        void writeSiteIndexes();
+
         // SEGMENTED SEQUENCE INTERFACE
 
         hal_size_t getSequenceLength() const;
@@ -164,6 +178,29 @@ namespace hal {
         char *getDNA(size_t start, size_t length) {
             return _data->getDNA(_alignment, start, length);
         }
+
+        /* is DNA stored in compressed blocks? */
+        bool isDnaCompressed() const {
+            return _alignment->getDnaBlockSize() != 0;
+        }
+        const MMapDnaBlocks *getDnaBlocks() const;
+
+        /* is DNA stored as 2-bit bases with N and lower-case runs? */
+        bool isDnaTwoBit() const {
+            return _alignment->isDnaTwoBit();
+        }
+        const MMapDnaTwoBit *getDnaTwoBit() const;
+
+        /* is DNA stored in an encoding that is buffered in memory for write? */
+        bool isDnaBuffered() const {
+            return isDnaCompressed() || isDnaTwoBit();
+        }
+        std::vector<char> &getDnaBuffer();
+        void markDnaBufferDirty() {
+            _dnaBufferDirty = true;
+        }
+        void writeDnaBuffer();
+        void releaseDnaBuffer();
         void createSequenceNameHash(size_t numSequences);
 
       private:
@@ -180,6 +217,12 @@ namespace hal {
         MMapMetaData _metaData;
         MMapPerfectHashTable _sequenceNameHash;
         MMapGenomeSiteMap _genomeSiteMap;
+        MMapTopSegmentArray _topSegments;
+        MMapBottomSegmentArray _bottomSegments;
+        std::vector<char> _dnaBuffer;         // packed DNA of compressed or 2-bit genome open for write
+        bool _dnaBufferDirty;                 // _dnaBuffer must be written on close
+        mutable MMapDnaBlocks *_dnaBlocks;    // reader of compressed DNA
+        mutable MMapDnaTwoBit *_dnaTwoBit;    // reader of 2-bit DNA
 
         mutable std::vector<MMapSequence *> _sequenceObjCache;
     };
@@ -198,24 +241,6 @@ namespace hal {
         _nameOffset = name.set(newName);
     }
 
-    inline MMapTopSegmentData *MMapGenomeData::getTopSegmentData(MMapAlignment *alignment, hal_index_t index) {
-        // We request twice the segment length here because checking the length of
-        // this segment requires reading the start position of the following
-        // segment.
-        return static_cast<MMapTopSegmentData *>(
-            alignment->resolveOffset(_topSegmentsOffset + index * sizeof(MMapTopSegmentData), 2 * sizeof(MMapTopSegmentData)));
-    }
-
-    inline MMapBottomSegmentData *MMapGenomeData::getBottomSegmentData(MMapAlignment *alignment, MMapGenome *genome,
-                                                                       hal_index_t index) {
-        size_t segmentSize = MMapBottomSegmentData::getSize(genome);
-        // We request twice the segment length here because checking the length of
-        // this segment requires reading the start position of the following
-        // segment.
-        return static_cast<MMapBottomSegmentData *>(
-            alignment->resolveOffset(_bottomSegmentsOffset + index * segmentSize, 2 * segmentSize));
-    }
-
     inline char *MMapGenomeData::getDNA(MMapAlignment *alignment, size_t start, size_t length) const {
         return static_cast<char *>(alignment->resolveOffset(_dnaOffset + start, length));
     }
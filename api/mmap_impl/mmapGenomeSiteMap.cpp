@@ -1,6 +1,8 @@
 #include "mmapGenomeSiteMap.h"
 #include "mmapRbTree.h"
 #include "mmapSequence.h"
+#include <algorithm>
+#include <cstring>
 using namespace std;
 using namespace hal;
 
@@ -30,6 +32,26 @@ namespace hal {
     }
 }
 
+/* Fill the Eytzinger array from sorted entries with an in-order walk of the
+ * implicit tree */
+static void eytzingerFill(const vector<pair<hal_size_t, hal_index_t>> &sorted, size_t &next, size_t k,
+                          hal_size_t *endPositions, hal_index_t *sequenceIndexes) {
+    if (k <= sorted.size()) {
+        eytzingerFill(sorted, next, 2 * k, endPositions, sequenceIndexes);
+        endPositions[k] = sorted[next].first;
+        sequenceIndexes[k] = sorted[next].second;
+        next++;
+        eytzingerFill(sorted, next, 2 * k + 1, endPositions, sequenceIndexes);
+    }
+}
+
+/* allocate an array aligned to a cache line */
+static size_t allocCacheAligned(MMapFile *file, size_t size) {
+    const size_t cacheLineSize = 64;
+    size_t offset = file->allocMem(size + cacheLineSize - 1);
+    return ((offset + cacheLineSize - 1) / cacheLineSize) * cacheLineSize;
+}
+
 /* calculate space required for the map in bytes */
 size_t hal::MMapGenomeSiteMap::calcRequiredSpace(size_t numSequences) {
     // root is in header
@@ -39,6 +61,10 @@ size_t hal::MMapGenomeSiteMap::calcRequiredSpace(size_t numSequences) {
 
 /* read header information */
 void hal::MMapGenomeSiteMap::readGsm(size_t gsmOffset) {
+    if (_eytzinger) {
+        readIndex(gsmOffset);
+        return;
+    }
     _gsmOffset = gsmOffset;
     _data = static_cast<MMapGenomeSiteMapData *>(_file->toPtr(gsmOffset, sizeof(MMapGenomeSiteMapData)));
     // prefetch full table
@@ -84,7 +110,48 @@ hal_index_t hal::MMapGenomeSiteMap::copyTree(struct rb_tree_node *tmpNode, int &
     return nodeIdx;
 }
 
+/* read header and arrays of the Eytzinger layout, fetching the arrays */
+void hal::MMapGenomeSiteMap::readIndex(size_t gsmOffset) {
+    _gsmOffset = gsmOffset;
+    _indexData = static_cast<const MMapGenomeSiteIndexData *>(_file->toPtr(gsmOffset, sizeof(MMapGenomeSiteIndexData)));
+    size_t arraySize = (_indexData->_numEntries + 1) * sizeof(hal_size_t);
+    _endPositions = static_cast<const hal_size_t *>(_file->toPtr(_indexData->_endPositionsOffset, arraySize));
+    _sequenceIndexes = static_cast<const hal_index_t *>(_file->toPtr(_indexData->_sequenceIndexesOffset, arraySize));
+}
+
+size_t hal::MMapGenomeSiteMap::buildIndex(const vector<MMapSequence *> &sequences) {
+    // empty sequences contain no positions
+    vector<pair<hal_size_t, hal_index_t>> sorted;
+    for (auto seq : sequences) {
+        if (seq->getSequenceLength() > 0) {
+            sorted.push_back(make_pair(seq->getStartPosition() + seq->getSequenceLength(), seq->getArrayIndex()));
+        }
+    }
+    sort(sorted.begin(), sorted.end());
+
+    MMapGenomeSiteIndexData indexData;
+    memset(&indexData, 0, sizeof(indexData));
+    indexData._numEntries = sorted.size();
+    size_t arraySize = (sorted.size() + 1) * sizeof(hal_size_t);
+    size_t gsmOffset = _file->allocMem(sizeof(MMapGenomeSiteIndexData));
+    indexData._endPositionsOffset = allocCacheAligned(_file, arraySize);
+    indexData._sequenceIndexesOffset = allocCacheAligned(_file, arraySize);
+    hal_size_t *endPositions = static_cast<hal_size_t *>(_file->toPtr(indexData._endPositionsOffset, arraySize));
+    hal_index_t *sequenceIndexes = static_cast<hal_index_t *>(_file->toPtr(indexData._sequenceIndexesOffset, arraySize));
+    endPositions[0] = 0; // unused
+    sequenceIndexes[0] = NULL_INDEX;
+    size_t next = 0;
+    eytzingerFill(sorted, next, 1, endPositions, sequenceIndexes);
+    *static_cast<MMapGenomeSiteIndexData *>(_file->toPtr(gsmOffset, sizeof(MMapGenomeSiteIndexData))) = indexData;
+    readIndex(gsmOffset);
+    return _gsmOffset;
+}
+
 size_t hal::MMapGenomeSiteMap::build(const vector<MMapSequence *> &sequences) {
+    return _eytzinger ? buildIndex(sequences) : buildTree(sequences);
+}
+
+size_t hal::MMapGenomeSiteMap::buildTree(const vector<MMapSequence *> &sequences) {
     struct rb_tree tmpTree;
     TmpTreeNodes tmpTreeNodes; // manages memory for tmp tree
 
@@ -96,7 +163,7 @@ size_t hal::MMapGenomeSiteMap::build(const vector<MMapSequence *> &sequences) {
     return _gsmOffset;
 }
 
-hal_index_t MMapGenomeSiteMap::getSequenceIndexBySite(size_t position) {
+hal_index_t MMapGenomeSiteMap::getSequenceIndexBySiteTree(size_t position) {
     assert(_gsmOffset != MMAP_NULL_OFFSET);
     const MMapGenomeSiteMapNode *node = getNodePtr(0);
     while (node != NULL) {
@@ -47,17 +47,32 @@ namespace hal {
         MMapGenomeSiteMapNode _root;
     };
 
+    /* header of the Eytzinger layout, added in mmap API 1.5 */
+    class MMapGenomeSiteIndexData {
+      public:
+        size_t _numEntries;            // number of non-empty sequences
+        size_t _endPositionsOffset;    // end positions in Eytzinger order, indexed from 1
+        size_t _sequenceIndexesOffset; // sequence index of each entry
+        char _reserved[40];
+    };
+
     /**
      * MMap file structure used to map position in genome to specific
-     * sequence.  This builds a balance binary tree and stores it in the
-     * mmapped file for direct access.
+     * sequence.  The end positions of the non-empty sequences are stored in
+     * Eytzinger (breadth-first) order, so a lookup is a branch-free descent
+     * of an implicit tree, with the first levels sharing cache lines and
+     * later levels prefetched.  Files before mmap API 1.5 store a
+     * pointer-linked balanced binary tree, which is still read and written
+     * for those files.
      */
     class MMapGenomeSiteMap {
       public:
         /** Construct new object for accessing site map in HAL file.
          * If the hash table is being created, then gsmOffset
          * should be MMAP_NULL_OFFSET.  */
-        MMapGenomeSiteMap(MMapFile *mmapFile, size_t gsmOffset) : _file(mmapFile), _gsmOffset(gsmOffset), _data(NULL) {
+        MMapGenomeSiteMap(MMapFile *mmapFile, size_t gsmOffset)
+            : _file(mmapFile), _gsmOffset(gsmOffset), _eytzinger(isEytzinger(mmapFile)), _data(NULL), _indexData(NULL),
+              _endPositions(NULL), _sequenceIndexes(NULL) {
             if (gsmOffset != MMAP_NULL_OFFSET) {
                 readGsm(gsmOffset);
             }
@@ -68,17 +83,45 @@ namespace hal {
         size_t build(const std::vector<MMapSequence *> &sequences);
 
         /** find the sequence index containing a position */
-        hal_index_t getSequenceIndexBySite(size_t position);
+        hal_index_t getSequenceIndexBySite(size_t position) {
+            return _eytzinger ? getSequenceIndexBySiteEytzinger(position) : getSequenceIndexBySiteTree(position);
+        }
 
         /** find the sequence containing a position */
         const Sequence *getSequenceBySite(hal_size_t position) const {
             return const_cast<MMapGenomeSiteMap *>(this)->getSequenceBySite(position);
         }
 
+        /* does the file use the Eytzinger layout? */
+        static bool isEytzinger(MMapFile *file) {
+            return file->getMinorVersion() >= 5;
+        }
+
       private:
         static size_t calcRequiredSpace(size_t numSequences);
         void readGsm(size_t gsmOffset);
         void createGsm(size_t numSequences);
+        void readIndex(size_t gsmOffset);
+        size_t buildIndex(const std::vector<MMapSequence *> &sequences);
+        size_t buildTree(const std::vector<MMapSequence *> &sequences);
+        hal_index_t getSequenceIndexBySiteTree(size_t position);
+
+        /* Descend the implicit tree to the first entry ending after the
+         * position, going right when the entry ends at or before it.  The
+         * path taken is the bits of k, so the answer is k with the trailing
+         * right turns and the final left turn removed. */
+        hal_index_t getSequenceIndexBySiteEytzinger(size_t position) const {
+            size_t k = 1;
+            while (k <= _indexData->_numEntries) {
+                __builtin_prefetch(_endPositions + k * EYTZINGER_PREFETCH_MULTIPLIER);
+                k = 2 * k + (_endPositions[k] <= position);
+            }
+            k >>= __builtin_ffsl(~k);
+            return (k == 0) ? NULL_INDEX : _sequenceIndexes[k];
+        }
+
+        /* entries per cache line, prefetching this many levels down */
+        static const size_t EYTZINGER_PREFETCH_MULTIPLIER = 64 / sizeof(hal_size_t);
         void loadTmpTree(const std::vector<MMapSequence *> &sequences, struct rb_tree *tmpTree, TmpTreeNodes &tmpTreeNodes);
         hal_index_t copyTree(struct rb_tree_node *tmpNode, int &nextNodeIdx);
 
@@ -98,7 +141,11 @@ namespace hal {
 
         MMapFile *_file;
         size_t _gsmOffset;
+        bool _eytzinger;
         MMapGenomeSiteMapData *_data;
+        const MMapGenomeSiteIndexData *_indexData;
+        const hal_size_t *_endPositions;
+        const hal_index_t *_sequenceIndexes;
     };
 }
 #endif
@@ -0,0 +1,124 @@
+#include "mmapPrefetcher.h"
+
+using namespace hal;
+using namespace std;
+
+MMapPrefetcher::MMapPrefetcher(size_t fileSize, size_t blockSize, FetchFunction fetch, FetchFunction backgroundFetch,
+                               size_t readAheadBlocks)
+    : _fileSize(fileSize), _blockSize(blockSize), _numBlocks((fileSize + blockSize - 1) / blockSize),
+      _readAheadBlocks(readAheadBlocks), _fetch(fetch), _backgroundFetch(backgroundFetch),
+      _blockStates(new atomic<uint8_t>[_numBlocks]), _numFetches(0), _workerBusy(false), _stop(false) {
+    for (size_t block = 0; block < _numBlocks; block++) {
+        _blockStates[block].store(0, memory_order_relaxed);
+    }
+}
+
+MMapPrefetcher::~MMapPrefetcher() {
+    {
+        lock_guard<mutex> guard(_mutex);
+        _stop = true;
+    }
+    _queueReady.notify_all();
+    if (_worker.joinable()) {
+        _worker.join();
+    }
+}
+
+/* Slow path of fetch(): handle read-ahead triggers in blocks first to last,
+ * then fetch the missing blocks, one call per run of adjacent blocks. */
+void MMapPrefetcher::fetchMissing(size_t first, size_t last) {
+    unique_lock<mutex> lock(_mutex);
+    last = min(last, _numBlocks - 1);
+    if (((_blockStates[first] & (BLOCK_PRESENT | BLOCK_PENDING)) == 0) && (first > 0) &&
+        (_blockStates[first - 1] & BLOCK_PRESENT)) {
+        queueReadAhead(last + 1); // sequential miss
+    }
+    for (size_t block = first; block <= last; block++) {
+        if (_blockStates[block] & BLOCK_TRIGGER) {
+            _blockStates[block].fetch_and(~BLOCK_TRIGGER, memory_order_release);
+            queueReadAhead(block + _readAheadBlocks);
+        }
+    }
+    for (size_t block = first; block <= last; block++) {
+        _blockDone.wait(lock, [&] { return not(_blockStates[block] & BLOCK_PENDING); });
+    }
+    _numFetches += fetchBlocks(lock, first, last + 1, _fetch);
+}
+
+/* queue a window of blocks starting at first to be read ahead, marking its
+ * first block to read ahead the following window when reached */
+void MMapPrefetcher::queueReadAhead(size_t first) {
+    if (first >= _numBlocks) {
+        return;
+    }
+    _blockStates[first].fetch_or(BLOCK_TRIGGER, memory_order_release);
+    _queue.push_back(BlockRange(first, min(first + _readAheadBlocks, _numBlocks)));
+    if (not _worker.joinable()) {
+        _worker = thread(&MMapPrefetcher::readAheadWorker, this);
+    }
+    _queueReady.notify_one();
+}
+
+/* Fetch blocks first to end (exclusive) that are neither present nor
+ * pending, with lock held on entry and exit but released while fetching.
+ * Returns the number of calls to fetchFunc.  If it fails, the blocks are
+ * left to be fetched again and the error is passed on. */
+size_t MMapPrefetcher::fetchBlocks(unique_lock<mutex> &lock, size_t first, size_t end, const FetchFunction &fetchFunc) {
+    size_t numCalls = 0;
+    for (size_t block = first; block < end;) {
+        if (_blockStates[block] & (BLOCK_PRESENT | BLOCK_PENDING)) {
+            block++;
+            continue;
+        }
+        size_t runEnd = block;
+        while ((runEnd < end) && not(_blockStates[runEnd] & (BLOCK_PRESENT | BLOCK_PENDING))) {
+            _blockStates[runEnd++].fetch_or(BLOCK_PENDING, memory_order_relaxed);
+        }
+        lock.unlock();
+        try {
+            fetchFunc(block * _blockSize, min(runEnd * _blockSize, _fileSize) - block * _blockSize);
+        } catch (...) {
+            lock.lock();
+            for (size_t i = block; i < runEnd; i++) {
+                _blockStates[i].fetch_and(~BLOCK_PENDING, memory_order_release);
+            }
+            _blockDone.notify_all();
+            throw;
+        }
+        lock.lock();
+        for (size_t i = block; i < runEnd; i++) {
+            _blockStates[i].store((_blockStates[i] & BLOCK_TRIGGER) | BLOCK_PRESENT, memory_order_release);
+        }
+        _blockDone.notify_all();
+        numCalls++;
+        block = runEnd;
+    }
+    return numCalls;
+}
+
+/* Background thread fetching queued read-ahead windows.  Errors are
+ * ignored, the blocks are fetched again when accessed. */
+void MMapPrefetcher::readAheadWorker() {
+    unique_lock<mutex> lock(_mutex);
+    while (true) {
+        _queueReady.wait(lock, [&] { return _stop || not _queue.empty(); });
+        if (_stop) {
+            break;
+        }
+        BlockRange range = _queue.front();
+        _queue.pop_front();
+        _workerBusy = true;
+        try {
+            fetchBlocks(lock, range.first, range.second, _backgroundFetch);
+        } catch (...) {
+            // blocks are fetched again when accessed
+        }
+        _workerBusy = false;
+        _blockDone.notify_all();
+    }
+}
+
+void MMapPrefetcher::waitForReadAhead() {
+    unique_lock<mutex> lock(_mutex);
+    _blockDone.wait(lock, [&] { return _queue.empty() && not _workerBusy; });
+}
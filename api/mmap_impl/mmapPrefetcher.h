@@ -0,0 +1,98 @@
+#ifndef _MMAPPREFETCHER_H
+#define _MMAPPREFETCHER_H
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace hal {
+    /* number of blocks read ahead of a sequential stream of accesses */
+    static const size_t MMAP_PREFETCH_READ_AHEAD_BLOCKS = 32;
+
+    /**
+     * Tracks which blocks of a remotely-backed file have been fetched, so
+     * that repeated requests for fetched data return without calling the
+     * fetch function, and requests for missing blocks are merged into one
+     * fetch per run of adjacent blocks.  A miss on the block following one
+     * already fetched is taken as a sequential stream: a window of blocks
+     * after it is read ahead by a background thread, and reaching the first
+     * block of that window reads ahead the next one, so the reader stays
+     * one to two windows behind.  Several streams (e.g. the segment and DNA
+     * arrays of a genome) are followed independently.
+     *
+     * The foreground and background fetch functions are only called from
+     * the caller's thread and the background thread respectively, so they
+     * may use separate handles that are not thread-safe.
+     */
+    class MMapPrefetcher {
+      public:
+        /* fetch length bytes at offset */
+        typedef std::function<void(size_t offset, size_t length)> FetchFunction;
+
+        MMapPrefetcher(size_t fileSize, size_t blockSize, FetchFunction fetch, FetchFunction backgroundFetch,
+                       size_t readAheadBlocks = MMAP_PREFETCH_READ_AHEAD_BLOCKS);
+        ~MMapPrefetcher();
+
+        /* ensure a range has been fetched, waiting if the background thread
+         * is fetching part of it */
+        void fetch(size_t offset, size_t length) {
+            size_t first = offset / _blockSize, last = (offset + std::max(length, size_t(1)) - 1) / _blockSize;
+            for (size_t block = first; block <= std::min(last, _numBlocks - 1); block++) {
+                if (_blockStates[block].load(std::memory_order_acquire) != BLOCK_PRESENT) {
+                    fetchMissing(first, last);
+                    return;
+                }
+            }
+        }
+
+        /* number of calls made to the foreground fetch function */
+        size_t getNumFetches() const {
+            return _numFetches;
+        }
+
+        /* wait until queued read-ahead is complete */
+        void waitForReadAhead();
+
+      private:
+        /* bit flags of a block's state */
+        enum : uint8_t {
+            BLOCK_PRESENT = 0x1, // fetched
+            BLOCK_PENDING = 0x2, // being fetched
+            BLOCK_TRIGGER = 0x4  // first block of a read-ahead window
+        };
+        typedef std::pair<size_t, size_t> BlockRange; // first block, end block (exclusive)
+
+        void fetchMissing(size_t first, size_t last);
+        void queueReadAhead(size_t first);
+        size_t fetchBlocks(std::unique_lock<std::mutex> &lock, size_t first, size_t end, const FetchFunction &fetchFunc);
+        void readAheadWorker();
+
+        size_t _fileSize;
+        size_t _blockSize;
+        size_t _numBlocks;
+        size_t _readAheadBlocks;
+        FetchFunction _fetch;
+        FetchFunction _backgroundFetch;
+        std::unique_ptr<std::atomic<uint8_t>[]> _blockStates;
+        size_t _numFetches;
+
+        std::mutex _mutex;                   // protects state changes and queue
+        std::condition_variable _blockDone;  // signalled when pending blocks are fetched
+        std::condition_variable _queueReady; // signalled when read-ahead is queued or on stop
+        std::deque<BlockRange> _queue;       // read-ahead windows to fetch
+        bool _workerBusy;
+        bool _stop;
+        std::thread _worker; // started on first read-ahead
+    };
+}
+#endif
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,223 @@
+#include "mmapSegmentArray.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace hal;
+
+/* Without a stored site index, one is built in memory for a read-only file
+ * once there have been this fraction of the number of segments lookups, so
+ * that reading all start positions costs little compared to the searches. */
+static const hal_size_t SITE_INDEX_BUILD_LOOKUP_RATIO = 16;
+
+/* width in bytes needed to store values up to maxValue */
+static uint32_t columnWidth(hal_size_t maxValue) {
+    return (maxValue < MMAP_NULL_INDEX32) ? sizeof(uint32_t) : sizeof(hal_index_t);
+}
+
+/* constructor, loading the header if the array exists */
+MMapSegmentArray::MMapSegmentArray(MMapAlignment *alignment, size_t offset)
+    : _alignment(alignment), _offset(offset), _columnar(isColumnar(alignment->getMMapFile())),
+      _mustFetch(alignment->getMMapFile()->isUdcProtocol()), _fileBase(NULL), _startPositions(NULL),
+      _parseIndexes(NULL), _linkIndexes(NULL), _paralogyIndexes(NULL), _reversedBits(NULL), _siteIndex(NULL), _siteIndexShift(0), _siteIndexLookups(0) {
+    if (not _mustFetch) {
+        _fileBase = static_cast<char *>(_alignment->resolveOffset(MMAP_NULL_OFFSET, 0));
+    }
+    memset(&_columns, 0, sizeof(_columns));
+    if (_columnar && (_offset != MMAP_NULL_OFFSET)) {
+        _columns = *static_cast<const MMapSegmentColumnsData *>(
+            _alignment->resolveOffset(_offset, sizeof(MMapSegmentColumnsData)));
+        if (not hasSiteIndex(alignment->getMMapFile())) {
+            // reserved space in older files
+            _columns._siteIndexOffset = MMAP_NULL_OFFSET;
+            _columns._siteIndexNumSamples = 0;
+            _columns._siteIndexShift = 0;
+        }
+        loadColumns();
+    }
+}
+
+/* compute column addresses in a local mapping from the header */
+void MMapSegmentArray::loadColumns() {
+    if (_fileBase != NULL) {
+        _startPositions = _fileBase + _columns._startPositionsOffset;
+        _parseIndexes = _fileBase + _columns._parseIndexesOffset;
+        _linkIndexes = _fileBase + _columns._linkIndexesOffset;
+        _paralogyIndexes = (_columns._paralogyIndexesOffset == MMAP_NULL_OFFSET)
+                               ? NULL
+                               : (_fileBase + _columns._paralogyIndexesOffset);
+        _reversedBits = _fileBase + _columns._reversedBitsOffset;
+        _siteIndex = (_columns._siteIndexOffset == MMAP_NULL_OFFSET) ? NULL : (_fileBase + _columns._siteIndexOffset);
+    }
+}
+
+/* allocate header and columns in one contiguous block and return the offset.
+ * Index widths are based on the genome's length, which bounds its number of
+ * segments. */
+size_t MMapSegmentArray::createColumns(hal_size_t numSegments, hal_size_t numChildren, hal_size_t sequenceLength, bool isTop) {
+    MMapSegmentColumnsData columns;
+    memset(&columns, 0, sizeof(columns));
+    columns._numSegments = numSegments;
+    columns._numChildren = numChildren;
+    columns._positionWidth = columnWidth(sequenceLength);
+    columns._indexWidth = columnWidth(sequenceLength);
+
+    size_t numLinks = isTop ? numSegments : numSegments * numChildren;
+    size_t headerSize = MMapFile::alignRound(sizeof(MMapSegmentColumnsData));
+    size_t positionsSize = MMapFile::alignRound((numSegments + 1) * columns._positionWidth);
+    size_t parseSize = MMapFile::alignRound(numSegments * columns._indexWidth);
+    size_t linksSize = MMapFile::alignRound(numLinks * columns._indexWidth);
+    size_t paralogySize = isTop ? parseSize : 0;
+    size_t reversedSize = ((numLinks + 63) / 64) * sizeof(uint64_t);
+
+    _offset = _alignment->allocateNewArray(headerSize + positionsSize + parseSize + linksSize + paralogySize + reversedSize);
+    columns._startPositionsOffset = _offset + headerSize;
+    columns._parseIndexesOffset = columns._startPositionsOffset + positionsSize;
+    columns._linkIndexesOffset = columns._parseIndexesOffset + parseSize;
+    columns._paralogyIndexesOffset = isTop ? (columns._linkIndexesOffset + linksSize) : MMAP_NULL_OFFSET;
+    columns._reversedBitsOffset = columns._linkIndexesOffset + linksSize + paralogySize;
+
+    *static_cast<MMapSegmentColumnsData *>(_alignment->resolveOffset(_offset, sizeof(MMapSegmentColumnsData))) = columns;
+    _columns = columns;
+    loadColumns();
+    return _offset;
+}
+
+/* Advise on the parts of each column holding segments first to last,
+ * including the following start position needed to get the length. */
+void MMapSegmentArray::adviseSegments(hal_index_t first, hal_index_t last, size_t legacySegmentSize,
+                                      AccessPattern pattern) const {
+    if ((_offset == MMAP_NULL_OFFSET) || (first > last)) {
+        return;
+    }
+    size_t count = last - first + 1;
+    if (not _columnar) {
+        _alignment->adviseAccess(_offset + first * legacySegmentSize, (count + 1) * legacySegmentSize, pattern);
+        return;
+    }
+    size_t linksPerSegment = std::max(_columns._numChildren, hal_size_t(1));
+    size_t positionWidth = _columns._positionWidth, indexWidth = _columns._indexWidth;
+    _alignment->adviseAccess(_columns._startPositionsOffset + first * positionWidth, (count + 1) * positionWidth, pattern);
+    _alignment->adviseAccess(_columns._parseIndexesOffset + first * indexWidth, count * indexWidth, pattern);
+    _alignment->adviseAccess(_columns._linkIndexesOffset + first * linksPerSegment * indexWidth,
+                             count * linksPerSegment * indexWidth, pattern);
+    if (_columns._paralogyIndexesOffset != MMAP_NULL_OFFSET) {
+        _alignment->adviseAccess(_columns._paralogyIndexesOffset + first * indexWidth, count * indexWidth, pattern);
+    }
+    size_t firstWord = (first * linksPerSegment) / 64, lastWord = ((last + 1) * linksPerSegment - 1) / 64;
+    _alignment->adviseAccess(_columns._reversedBitsOffset + firstWord * sizeof(uint64_t),
+                             (lastWord - firstWord + 1) * sizeof(uint64_t), pattern);
+}
+
+/* start position of a segment in either layout, the start position of the
+ * segment past the end is the genome length */
+hal_index_t MMapSegmentArray::getAnyStartPosition(hal_index_t i, size_t legacySegmentSize) const {
+    if (_columnar) {
+        return getColumnPosition(i);
+    } else {
+        return *static_cast<const hal_index_t *>(
+            _alignment->resolveOffset(_offset + i * legacySegmentSize, sizeof(hal_index_t)));
+    }
+}
+
+/* Sample the index of the segment overlapping every 2^shift bases, with the
+ * shift chosen to give about one sample per segment.  Returns the shift. */
+uint32_t MMapSegmentArray::buildSiteIndex(hal_size_t numSegments, size_t legacySegmentSize,
+                                          std::vector<hal_index_t> &samples) const {
+    hal_size_t length = getAnyStartPosition(numSegments, legacySegmentSize);
+    uint32_t shift = 0;
+    while ((length >> shift) > numSegments) {
+        shift++;
+    }
+    samples.resize((length > 0) ? ((length - 1) >> shift) + 1 : 0);
+    hal_index_t i = 0;
+    hal_index_t nextStartPosition = getAnyStartPosition(1, legacySegmentSize);
+    for (size_t j = 0; j < samples.size(); j++) {
+        hal_index_t position = hal_index_t(j) << shift;
+        while ((i + 1 < hal_index_t(numSegments)) && (nextStartPosition <= position)) {
+            i++;
+            nextStartPosition = getAnyStartPosition(i + 1, legacySegmentSize);
+        }
+        samples[j] = i;
+    }
+    return shift;
+}
+
+/* The segment overlapping a position is between the samples before and
+ * after it. */
+bool MMapSegmentArray::getSiteRange(hal_index_t position, hal_size_t numSegments, size_t legacySegmentSize,
+                                    hal_index_t &first, hal_index_t &last) const {
+    if ((_offset == MMAP_NULL_OFFSET) || (numSegments == 0) || (position < 0)) {
+        return false;
+    }
+    if (_columns._siteIndexOffset != MMAP_NULL_OFFSET) {
+        size_t j = position >> _columns._siteIndexShift;
+        if (j >= _columns._siteIndexNumSamples) {
+            return false;
+        }
+        first = getColumnIndex(_siteIndex, _columns._siteIndexOffset, j);
+        last = (j + 1 < _columns._siteIndexNumSamples) ? getColumnIndex(_siteIndex, _columns._siteIndexOffset, j + 1)
+                                                       : hal_index_t(numSegments - 1);
+        return true;
+    }
+    if (_siteIndexSamples.empty()) {
+        // positions can only change if the file is writable
+        if ((not _alignment->isReadOnly()) || (++_siteIndexLookups < numSegments / SITE_INDEX_BUILD_LOOKUP_RATIO)) {
+            return false;
+        }
+        _siteIndexShift = buildSiteIndex(numSegments, legacySegmentSize, _siteIndexSamples);
+        if (_siteIndexSamples.empty()) {
+            return false;
+        }
+    }
+    size_t j = position >> _siteIndexShift;
+    if (j >= _siteIndexSamples.size()) {
+        return false;
+    }
+    first = _siteIndexSamples[j];
+    last = (j + 1 < _siteIndexSamples.size()) ? _siteIndexSamples[j + 1] : hal_index_t(numSegments - 1);
+    return true;
+}
+
+void MMapSegmentArray::writeSiteIndex(hal_size_t numSegments) {
+    if ((not _columnar) || (not hasSiteIndex(_alignment->getMMapFile())) || (_offset == MMAP_NULL_OFFSET) ||
+        (numSegments == 0) || (_columns._siteIndexOffset != MMAP_NULL_OFFSET)) {
+        return;
+    }
+    std::vector<hal_index_t> samples;
+    uint32_t shift = buildSiteIndex(numSegments, 0, samples);
+    _columns._siteIndexOffset = _alignment->allocateNewArray(samples.size() * _columns._indexWidth);
+    _columns._siteIndexNumSamples = samples.size();
+    _columns._siteIndexShift = shift;
+    loadColumns();
+    for (size_t j = 0; j < samples.size(); j++) {
+        setColumnIndex(_siteIndex, _columns._siteIndexOffset, j, samples[j]);
+    }
+    *static_cast<MMapSegmentColumnsData *>(_alignment->resolveOffset(_offset, sizeof(MMapSegmentColumnsData))) = _columns;
+}
+
+/* drop the stored site index, its space is not reclaimed */
+void MMapSegmentArray::clearSiteIndex() {
+    _columns._siteIndexOffset = MMAP_NULL_OFFSET;
+    _columns._siteIndexNumSamples = 0;
+    _columns._siteIndexShift = 0;
+    _siteIndex = NULL;
+    *static_cast<MMapSegmentColumnsData *>(_alignment->resolveOffset(_offset, sizeof(MMapSegmentColumnsData))) = _columns;
+}
+
+size_t MMapTopSegmentArray::create(hal_size_t numSegments, hal_size_t sequenceLength) {
+    if (_columnar) {
+        return createColumns(numSegments, 0, sequenceLength, true);
+    } else {
+        _offset = _alignment->allocateNewArray((numSegments + 1) * sizeof(MMapTopSegmentData));
+        return _offset;
+    }
+}
+
+size_t MMapBottomSegmentArray::create(hal_size_t numSegments, hal_size_t numChildren, hal_size_t sequenceLength) {
+    if (_columnar) {
+        return createColumns(numSegments, numChildren, sequenceLength, false);
+    } else {
+        _offset = _alignment->allocateNewArray((numSegments + 1) * MMapBottomSegmentData::getSize(_genome));
+        return _offset;
+    }
+}
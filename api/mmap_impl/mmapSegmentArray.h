@@ -0,0 +1,318 @@
+#ifndef _MMAPSEGMENTARRAY_H
+#define _MMAPSEGMENTARRAY_H
+#include "halGenome.h"
+#include "mmapAlignment.h"
+#include "mmapBottomSegmentData.h"
+#include "mmapTopSegmentData.h"
+#include <cstdint>
+#include <vector>
+
+namespace hal {
+    /* Header of a column-wise segment array, used starting with mmap API 1.2.
+     * Each segment field is stored in its own array, using four bytes per
+     * value when the genome is small enough, and the reversed flags are packed
+     * one bit per segment (or per child of a bottom segment). */
+    class MMapSegmentColumnsData {
+      public:
+        hal_size_t _numSegments;
+        hal_size_t _numChildren;       // child links per bottom segment
+        uint32_t _positionWidth;       // bytes per start position (4 or 8)
+        uint32_t _indexWidth;          // bytes per segment index (4 or 8)
+        size_t _startPositionsOffset;  // _numSegments + 1 positions
+        size_t _parseIndexesOffset;    // bottom parse index or top parse index
+        size_t _linkIndexesOffset;     // parent index or _numChildren child indexes
+        size_t _paralogyIndexesOffset; // top segments only
+        size_t _reversedBitsOffset;    // bit per parent or child link
+        size_t _siteIndexOffset;       // segment at every 2^_siteIndexShift bases, or NULL (mmap API 1.6)
+        hal_size_t _siteIndexNumSamples;
+        uint32_t _siteIndexShift;
+        char _reserved[44];
+    };
+
+    /**
+     * Access to a segment array of a genome stored in either the column-wise
+     * layout or the array-of-structs layout of files before mmap API 1.2.
+     * Segment objects cache a pointer to the struct of the older layout, so
+     * the per-index accessors here only handle the column-wise layout.  Column
+     * addresses are computed once from the file base, which never moves; with
+     * UDC, each element is fetched on access.
+     */
+    class MMapSegmentArray {
+      public:
+        /* does this file store segments column-wise? */
+        static bool isColumnar(MMapFile *file) {
+            return file->getMinorVersion() >= 2;
+        }
+        bool isColumnar() const {
+            return _columnar;
+        }
+
+        /* does this file store sampled site indexes in column-wise segment arrays? */
+        static bool hasSiteIndex(MMapFile *file) {
+            return file->getMinorVersion() >= 6;
+        }
+
+        /* build the sampled site index of a column-wise array and store it
+         * in the file, if it doesn't have a current one */
+        void writeSiteIndex(hal_size_t numSegments);
+
+      protected:
+        MMapSegmentArray(MMapAlignment *alignment, size_t offset);
+        size_t createColumns(hal_size_t numSegments, hal_size_t numChildren, hal_size_t sequenceLength, bool isTop);
+        void loadColumns();
+        void adviseSegments(hal_index_t first, hal_index_t last, size_t legacySegmentSize, AccessPattern pattern) const;
+        hal_index_t getAnyStartPosition(hal_index_t i, size_t legacySegmentSize) const;
+        uint32_t buildSiteIndex(hal_size_t numSegments, size_t legacySegmentSize, std::vector<hal_index_t> &samples) const;
+        bool getSiteRange(hal_index_t position, hal_size_t numSegments, size_t legacySegmentSize, hal_index_t &first,
+                          hal_index_t &last) const;
+
+        /* drop the sampled site index when a start position changes */
+        void invalidateSiteIndex() {
+            if (_columns._siteIndexOffset != MMAP_NULL_OFFSET) {
+                clearSiteIndex();
+            }
+        }
+        void clearSiteIndex();
+
+        inline hal_index_t getColumnIndex(char *column, size_t columnOffset, size_t i) const;
+        inline void setColumnIndex(char *column, size_t columnOffset, size_t i, hal_index_t value);
+        inline hal_index_t getColumnPosition(size_t i) const;
+        inline void setColumnPosition(size_t i, hal_index_t position);
+        inline bool getColumnBit(size_t i) const;
+        inline void setColumnBit(size_t i, bool value);
+
+        /* address of bytes within a column, fetching them if required */
+        char *columnPtr(char *column, size_t columnOffset, size_t byteOffset, size_t size) const {
+            if (_mustFetch) {
+                return static_cast<char *>(_alignment->resolveOffset(columnOffset + byteOffset, size));
+            } else {
+                return column + byteOffset;
+            }
+        }
+
+        MMapAlignment *_alignment;
+        size_t _offset;
+        bool _columnar;
+        bool _mustFetch;                 // UDC file
+        char *_fileBase;                 // start of local file mapping
+        MMapSegmentColumnsData _columns; // copy of header when columnar
+        // column addresses in a local file mapping
+        char *_startPositions;
+        char *_parseIndexes;
+        char *_linkIndexes;
+        char *_paralogyIndexes;
+        char *_reversedBits;
+        char *_siteIndex;
+        // site index built in memory when the file doesn't have one
+        mutable std::vector<hal_index_t> _siteIndexSamples;
+        mutable uint32_t _siteIndexShift;
+        mutable hal_size_t _siteIndexLookups; // lookups without an index so far
+    };
+
+    /* top segments of a genome */
+    class MMapTopSegmentArray : public MMapSegmentArray {
+      public:
+        MMapTopSegmentArray(MMapAlignment *alignment, size_t offset) : MMapSegmentArray(alignment, offset) {
+        }
+
+        /* allocate a new array, returning the offset */
+        size_t create(hal_size_t numSegments, hal_size_t sequenceLength);
+
+        /* pass an access pattern hint for segments first to last to the file */
+        void adviseAccess(hal_index_t first, hal_index_t last, AccessPattern pattern) const {
+            adviseSegments(first, last, sizeof(MMapTopSegmentData), pattern);
+        }
+
+        /* Get a range of segments that includes the one overlapping a
+         * position from the sampled site index.  Returns false if there
+         * isn't an index. */
+        bool getSiteIndexRange(hal_index_t position, hal_size_t numSegments, hal_index_t &first, hal_index_t &last) const {
+            return getSiteRange(position, numSegments, sizeof(MMapTopSegmentData), first, last);
+        }
+
+        /* segment struct of files before mmap API 1.2, NULL if columnar */
+        MMapTopSegmentData *getLegacyData(hal_index_t i) const {
+            if (_columnar) {
+                return NULL;
+            }
+            // We request twice the segment length here because checking the length of
+            // this segment requires reading the start position of the following
+            // segment.
+            return static_cast<MMapTopSegmentData *>(
+                _alignment->resolveOffset(_offset + i * sizeof(MMapTopSegmentData), 2 * sizeof(MMapTopSegmentData)));
+        }
+
+        hal_index_t getStartPosition(hal_index_t i) const {
+            return getColumnPosition(i);
+        }
+        void setStartPosition(hal_index_t i, hal_index_t startPosition) {
+            invalidateSiteIndex();
+            setColumnPosition(i, startPosition);
+        }
+        hal_index_t getBottomParseIndex(hal_index_t i) const {
+            return getColumnIndex(_parseIndexes, _columns._parseIndexesOffset, i);
+        }
+        void setBottomParseIndex(hal_index_t i, hal_index_t parseIndex) {
+            setColumnIndex(_parseIndexes, _columns._parseIndexesOffset, i, parseIndex);
+        }
+        hal_index_t getNextParalogyIndex(hal_index_t i) const {
+            return getColumnIndex(_paralogyIndexes, _columns._paralogyIndexesOffset, i);
+        }
+        void setNextParalogyIndex(hal_index_t i, hal_index_t paralogyIndex) {
+            setColumnIndex(_paralogyIndexes, _columns._paralogyIndexesOffset, i, paralogyIndex);
+        }
+        hal_index_t getParentIndex(hal_index_t i) const {
+            return getColumnIndex(_linkIndexes, _columns._linkIndexesOffset, i);
+        }
+        void setParentIndex(hal_index_t i, hal_index_t parentIndex) {
+            setColumnIndex(_linkIndexes, _columns._linkIndexesOffset, i, parentIndex);
+        }
+        bool getReversed(hal_index_t i) const {
+            return getColumnBit(i);
+        }
+        void setReversed(hal_index_t i, bool reversed) {
+            setColumnBit(i, reversed);
+        }
+    };
+
+    /* bottom segments of a genome */
+    class MMapBottomSegmentArray : public MMapSegmentArray {
+      public:
+        MMapBottomSegmentArray(MMapAlignment *alignment, const Genome *genome, size_t offset)
+            : MMapSegmentArray(alignment, offset), _genome(genome) {
+        }
+
+        /* allocate a new array, returning the offset */
+        size_t create(hal_size_t numSegments, hal_size_t numChildren, hal_size_t sequenceLength);
+
+        /* pass an access pattern hint for segments first to last to the file */
+        void adviseAccess(hal_index_t first, hal_index_t last, AccessPattern pattern) const {
+            adviseSegments(first, last, MMapBottomSegmentData::getSize(_genome), pattern);
+        }
+
+        /* Get a range of segments that includes the one overlapping a
+         * position from the sampled site index.  Returns false if there
+         * isn't an index. */
+        bool getSiteIndexRange(hal_index_t position, hal_size_t numSegments, hal_index_t &first, hal_index_t &last) const {
+            return getSiteRange(position, numSegments, MMapBottomSegmentData::getSize(_genome), first, last);
+        }
+
+        /* segment struct of files before mmap API 1.2, NULL if columnar */
+        MMapBottomSegmentData *getLegacyData(hal_index_t i) const {
+            if (_columnar) {
+                return NULL;
+            }
+            size_t segmentSize = MMapBottomSegmentData::getSize(_genome);
+            // We request twice the segment length here because checking the length of
+            // this segment requires reading the start position of the following
+            // segment.
+            return static_cast<MMapBottomSegmentData *>(
+                _alignment->resolveOffset(_offset + i * segmentSize, 2 * segmentSize));
+        }
+
+        hal_index_t getStartPosition(hal_index_t i) const {
+            return getColumnPosition(i);
+        }
+        void setStartPosition(hal_index_t i, hal_index_t startPosition) {
+            invalidateSiteIndex();
+            setColumnPosition(i, startPosition);
+        }
+        hal_index_t getTopParseIndex(hal_index_t i) const {
+            return getColumnIndex(_parseIndexes, _columns._parseIndexesOffset, i);
+        }
+        void setTopParseIndex(hal_index_t i, hal_index_t parseIndex) {
+            setColumnIndex(_parseIndexes, _columns._parseIndexesOffset, i, parseIndex);
+        }
+        hal_index_t getChildIndex(hal_index_t i, hal_size_t child) const {
+            return getColumnIndex(_linkIndexes, _columns._linkIndexesOffset, linkIndex(i, child));
+        }
+        void setChildIndex(hal_index_t i, hal_size_t child, hal_index_t childIndex) {
+            setColumnIndex(_linkIndexes, _columns._linkIndexesOffset, linkIndex(i, child), childIndex);
+        }
+        bool getChildReversed(hal_index_t i, hal_size_t child) const {
+            return getColumnBit(linkIndex(i, child));
+        }
+        void setChildReversed(hal_index_t i, hal_size_t child, bool childReversed) {
+            setColumnBit(linkIndex(i, child), childReversed);
+        }
+
+      private:
+        size_t linkIndex(hal_index_t i, hal_size_t child) const {
+            assert(child < _columns._numChildren);
+            return i * _columns._numChildren + child;
+        }
+        const Genome *_genome;
+    };
+
+    /* value stored in four byte index columns for NULL_INDEX */
+    static const uint32_t MMAP_NULL_INDEX32 = UINT32_MAX;
+
+    hal_index_t MMapSegmentArray::getColumnIndex(char *column, size_t columnOffset, size_t i) const {
+        assert(_columnar);
+        if (_columns._indexWidth == sizeof(uint32_t)) {
+            uint32_t value = *reinterpret_cast<const uint32_t *>(
+                columnPtr(column, columnOffset, i * sizeof(uint32_t), sizeof(uint32_t)));
+            return (value == MMAP_NULL_INDEX32) ? NULL_INDEX : hal_index_t(value);
+        } else {
+            return *reinterpret_cast<const hal_index_t *>(
+                columnPtr(column, columnOffset, i * sizeof(hal_index_t), sizeof(hal_index_t)));
+        }
+    }
+
+    void MMapSegmentArray::setColumnIndex(char *column, size_t columnOffset, size_t i, hal_index_t value) {
+        assert(_columnar);
+        if (_columns._indexWidth == sizeof(uint32_t)) {
+            if ((value != NULL_INDEX) && ((value < 0) || (value >= hal_index_t(MMAP_NULL_INDEX32)))) {
+                throw hal_exception("segment index " + std::to_string(value) +
+                                    " is too large for the compact segment layout of this genome");
+            }
+            *reinterpret_cast<uint32_t *>(columnPtr(column, columnOffset, i * sizeof(uint32_t), sizeof(uint32_t))) =
+                (value == NULL_INDEX) ? MMAP_NULL_INDEX32 : uint32_t(value);
+        } else {
+            *reinterpret_cast<hal_index_t *>(
+                columnPtr(column, columnOffset, i * sizeof(hal_index_t), sizeof(hal_index_t))) = value;
+        }
+    }
+
+    hal_index_t MMapSegmentArray::getColumnPosition(size_t i) const {
+        assert(_columnar);
+        if (_columns._positionWidth == sizeof(uint32_t)) {
+            return *reinterpret_cast<const uint32_t *>(
+                columnPtr(_startPositions, _columns._startPositionsOffset, i * sizeof(uint32_t), sizeof(uint32_t)));
+        } else {
+            return *reinterpret_cast<const hal_index_t *>(columnPtr(
+                _startPositions, _columns._startPositionsOffset, i * sizeof(hal_index_t), sizeof(hal_index_t)));
+        }
+    }
+
+    void MMapSegmentArray::setColumnPosition(size_t i, hal_index_t position) {
+        assert(_columnar);
+        if (_columns._positionWidth == sizeof(uint32_t)) {
+            assert((position >= 0) && (position <= hal_index_t(UINT32_MAX)));
+            *reinterpret_cast<uint32_t *>(columnPtr(_startPositions, _columns._startPositionsOffset,
+                                                    i * sizeof(uint32_t), sizeof(uint32_t))) = uint32_t(position);
+        } else {
+            *reinterpret_cast<hal_index_t *>(columnPtr(_startPositions, _columns._startPositionsOffset,
+                                                       i * sizeof(hal_index_t), sizeof(hal_index_t))) = position;
+        }
+    }
+
+    bool MMapSegmentArray::getColumnBit(size_t i) const {
+        assert(_columnar);
+        const uint64_t *word = reinterpret_cast<const uint64_t *>(
+            columnPtr(_reversedBits, _columns._reversedBitsOffset, (i / 64) * sizeof(uint64_t), sizeof(uint64_t)));
+        return (*word >> (i % 64)) & 1;
+    }
+
+    void MMapSegmentArray::setColumnBit(size_t i, bool value) {
+        assert(_columnar);
+        uint64_t *word = reinterpret_cast<uint64_t *>(
+            columnPtr(_reversedBits, _columns._reversedBitsOffset, (i / 64) * sizeof(uint64_t), sizeof(uint64_t)));
+        uint64_t mask = uint64_t(1) << (i % 64);
+        *word = value ? (*word | mask) : (*word & ~mask);
+    }
+}
+#endif
+// Local Variables:
+// mode: c++
+// End:
@@ -4,24 +4,26 @@
 #include "halGenome.h"
 #include "halTopSegment.h"
 #include "mmapGenome.h"
-#include "mmapTopSegmentData.h"
+#include "mmapSegmentArray.h"
 
 namespace hal {
     class MMapTopSegment : public TopSegment {
       public:
         MMapTopSegment(MMapGenome *genome, hal_index_t arrayIndex)
-            : TopSegment(genome, arrayIndex), _data(getMMapGenome()->getTopSegmentPointer(arrayIndex)) {
+            : TopSegment(genome, arrayIndex), _array(genome->getTopSegmentArray()),
+              _data(_array->getLegacyData(arrayIndex)) {
         }
 
         // SEGMENT INTERFACE
         void setArrayIndex(Genome *genome, hal_index_t arrayIndex) {
             _genome = genome;
-            _data = getMMapGenome()->getTopSegmentPointer(arrayIndex);
+            _array = getMMapGenome()->getTopSegmentArray();
+            _data = _array->getLegacyData(arrayIndex);
             _index = arrayIndex;
         }
         const Sequence *getSequence() const;
         hal_index_t getStartPosition() const {
-            return _data->getStartPosition();
+            return (_data != NULL) ? _data->getStartPosition() : _array->getStartPosition(_index);
         };
         hal_index_t getEndPosition() const;
         hal_size_t getLength() const;
@@ -33,32 +35,48 @@ namespace hal {
 
         // TOP SEGMENT INTERFACE
         hal_index_t getParentIndex() const {
-            return _data->getParentIndex();
+            return (_data != NULL) ? _data->getParentIndex() : _array->getParentIndex(_index);
         };
         bool hasParent() const;
         void setParentIndex(hal_index_t parIdx) {
-            _data->setParentIndex(parIdx);
+            if (_data != NULL) {
+                _data->setParentIndex(parIdx);
+            } else {
+                _array->setParentIndex(_index, parIdx);
+            }
         };
         bool getParentReversed() const {
-            return _data->getReversed();
+            return (_data != NULL) ? _data->getReversed() : _array->getReversed(_index);
         };
         void setParentReversed(bool isReversed) {
-            _data->setReversed(isReversed);
+            if (_data != NULL) {
+                _data->setReversed(isReversed);
+            } else {
+                _array->setReversed(_index, isReversed);
+            }
         };
         hal_index_t getBottomParseIndex() const {
-            return _data->getBottomParseIndex();
+            return (_data != NULL) ? _data->getBottomParseIndex() : _array->getBottomParseIndex(_index);
         };
         void setBottomParseIndex(hal_index_t botParseIdx) {
-            _data->setBottomParseIndex(botParseIdx);
+            if (_data != NULL) {
+                _data->setBottomParseIndex(botParseIdx);
+            } else {
+                _array->setBottomParseIndex(_index, botParseIdx);
+            }
         };
         hal_offset_t getBottomParseOffset() const;
         bool hasParseDown() const;
         hal_index_t getNextParalogyIndex() const {
-            return _data->getNextParalogyIndex();
+            return (_data != NULL) ? _data->getNextParalogyIndex() : _array->getNextParalogyIndex(_index);
         }
         bool hasNextParalogy() const;
         void setNextParalogyIndex(hal_index_t parIdx) {
-            _data->setNextParalogyIndex(parIdx);
+            if (_data != NULL) {
+                _data->setNextParalogyIndex(parIdx);
+            } else {
+                _array->setNextParalogyIndex(_index, parIdx);
+            }
         };
         hal_index_t getLeftParentIndex() const;
         hal_index_t getRightParentIndex() const;
@@ -68,7 +86,8 @@ namespace hal {
         MMapGenome *getMMapGenome() const {
             return static_cast<MMapGenome *>(_genome);
         }
-        MMapTopSegmentData *_data;
+        MMapTopSegmentArray *_array;
+        MMapTopSegmentData *_data; // NULL unless file predates columnar segments
     };
 
     inline hal_index_t MMapTopSegment::getEndPosition() const {
@@ -76,7 +95,10 @@ namespace hal {
     }
 
     inline hal_size_t MMapTopSegment::getLength() const {
-        return (_data + 1)->getStartPosition() - _data->getStartPosition();
+        if (_data != NULL) {
+            return (_data + 1)->getStartPosition() - _data->getStartPosition();
+        }
+        return _array->getStartPosition(_index + 1) - _array->getStartPosition(_index);
     }
 
     inline const Sequence *MMapTopSegment::getSequence() const {
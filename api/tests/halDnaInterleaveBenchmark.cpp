@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+/* Microbenchmark of several DnaIterators on one genome reading bases in
+ * turn, each from a different random starting position. */
+
+#include "halAlignmentInstance.h"
+#include "halCLParser.h"
+#include "halDnaIterator.h"
+#include "halGenome.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace hal;
+
+int main(int argc, char **argv) {
+    CLParser optionsParser;
+    optionsParser.setDescription("Time interleaved reads of DNA by several iterators on one genome");
+    optionsParser.addArgument("halFile", "path to hal file");
+    optionsParser.addOption("genome", "genome to read DNA from, default is the root", "\"\"");
+    optionsParser.addOption("numIterators", "number of iterators reading in turn", 2);
+    optionsParser.addOption("numBases", "number of bases to read in total", 10000000);
+    optionsParser.addOption("seed", "random number seed", 0);
+    string path, genomeName;
+    hal_size_t numIterators, numBases;
+    unsigned seed;
+    try {
+        optionsParser.parseOptions(argc, argv);
+        path = optionsParser.getArgument<string>("halFile");
+        genomeName = optionsParser.getOption<string>("genome");
+        numIterators = optionsParser.getOption<hal_size_t>("numIterators");
+        numBases = optionsParser.getOption<hal_size_t>("numBases");
+        seed = optionsParser.getOption<unsigned>("seed");
+    } catch (exception &e) {
+        cerr << e.what() << endl;
+        optionsParser.printUsage(cerr);
+        return 1;
+    }
+    try {
+        AlignmentConstPtr alignment(openHalAlignment(path, &optionsParser));
+        if (genomeName == "\"\"") {
+            genomeName = alignment->getRootName();
+        }
+        const Genome *genome = alignment->openGenome(genomeName);
+        if (genome == NULL) {
+            throw hal_exception("Genome " + genomeName + " not found");
+        }
+        hal_size_t basesPerIterator = numBases / numIterators;
+        if ((numIterators == 0) || (genome->getSequenceLength() <= basesPerIterator)) {
+            throw hal_exception("genome " + genomeName + " is too short for the number of bases per iterator");
+        }
+        mt19937_64 rng(seed);
+        uniform_int_distribution<hal_size_t> positionDist(0, genome->getSequenceLength() - basesPerIterator - 1);
+        vector<DnaIteratorPtr> dnaIts;
+        for (hal_size_t i = 0; i < numIterators; i++) {
+            dnaIts.push_back(genome->getDnaIterator(positionDist(rng)));
+        }
+
+        hal_size_t checksum = 0;
+        auto start = chrono::steady_clock::now();
+        for (hal_size_t i = 0; i < basesPerIterator; i++) {
+            for (auto &dnaIt : dnaIts) {
+                checksum += dnaIt->getBase();
+                dnaIt->toRight();
+            }
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        hal_size_t basesRead = basesPerIterator * numIterators;
+        cout << "iterators: " << numIterators << " bases: " << basesRead << " seconds: " << seconds
+             << " bases/sec: " << (basesRead / seconds) << " checksum: " << checksum << endl;
+    } catch (exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -7,15 +7,20 @@
 #include "halApiTestSupport.h"
 #include "halAlignment.h"
 #include "halBottomSegmentIterator.h"
+#include "halCLParser.h"
 #include "halColumnIterator.h"
 #include "halDnaIterator.h"
 #include "halGenome.h"
 #include "halMetaData.h"
 #include "halTopSegmentIterator.h"
 #include "halValidate.h"
+#include "hdf5Alignment.h"
+#include "mmapPrefetcher.h"
 #include <iostream>
 #include <stdio.h>
 #include <string>
+#include <sys/stat.h>
+#include <thread>
 extern "C" {
 #include "commonC.h"
 }
@@ -138,6 +143,54 @@ struct GenomeStringTest : public AlignmentTest {
     void checkCallBack(AlignmentConstPtr alignment) {
         const Genome *ancGenome = alignment->openGenome("AncGenome");
         CuAssertTrue(_testCase, ancGenome->getName() == "AncGenome");
+        // access hints, including ones out of range, don't change results
+        alignment->setAccessPattern(ACCESS_SEQUENTIAL);
+        ancGenome->setAccessPattern(ACCESS_WILLNEED, 1001, 100000);
+        ancGenome->setAccessPattern(ACCESS_RANDOM, _string.size() - 10, 1000);
+        ancGenome->setAccessPattern(ACCESS_NORMAL, _string.size() + 10);
+        string genomeString;
+        ancGenome->getString(genomeString);
+        CuAssertTrue(_testCase, genomeString == _string);
+    }
+};
+
+/* iterators at distant positions of one genome, used in turn */
+struct GenomeDnaIteratorsTest : public AlignmentTest {
+    std::string _string;
+    void createCallBack(AlignmentPtr alignment) {
+        hal_size_t seqLength = 1000001;
+        Genome *ancGenome = alignment->addRootGenome("AncGenome", 0);
+        vector<Sequence::Info> seqVec(1);
+        seqVec[0] = Sequence::Info("Sequence", seqLength, 0, 1000);
+        ancGenome->setDimensions(seqVec);
+
+        _string = randomString(seqLength);
+        hal_size_t half = seqLength / 2;
+        DnaIteratorPtr leftIt = ancGenome->getDnaIterator(0);
+        DnaIteratorPtr rightIt = ancGenome->getDnaIterator(half);
+        for (hal_size_t i = 0; i < half; i++) {
+            leftIt->setBase(_string[i]);
+            leftIt->toRight();
+            rightIt->setBase(_string[half + i]);
+            rightIt->toRight();
+        }
+        rightIt->setBase(_string[seqLength - 1]);
+        leftIt->flush();
+        rightIt->flush();
+    }
+
+    void checkCallBack(AlignmentConstPtr alignment) {
+        const Genome *ancGenome = alignment->openGenome("AncGenome");
+        hal_size_t half = _string.size() / 2;
+        DnaIteratorPtr leftIt = ancGenome->getDnaIterator(0);
+        DnaIteratorPtr rightIt = ancGenome->getDnaIterator(half);
+        for (hal_size_t i = 0; i < half; i++) {
+            CuAssertTrue(_testCase, leftIt->getBase() == _string[i]);
+            leftIt->toRight();
+            CuAssertTrue(_testCase, rightIt->getBase() == _string[half + i]);
+            rightIt->toRight();
+        }
+        CuAssertTrue(_testCase, rightIt->getBase() == _string[_string.size() - 1]);
         string genomeString;
         ancGenome->getString(genomeString);
         CuAssertTrue(_testCase, genomeString == _string);
@@ -531,6 +584,93 @@ struct GenomeCopySegmentsWhenSequencesOutOfOrderTest : public AlignmentTest {
     }
 };
 
+/* segments copied and rewritten in blocks, and DNA read in strings */
+struct GenomeSegmentBlockTest : public AlignmentTest {
+    std::string _string;
+    void createCallBack(AlignmentPtr alignment) {
+        Genome *ancGenome = alignment->addRootGenome("AncGenome", 0);
+        Genome *leaf1Genome = alignment->addLeafGenome("Leaf1", "AncGenome", 0);
+        Genome *leaf2Genome = alignment->addLeafGenome("Leaf2", "AncGenome", 0);
+        vector<Sequence::Info> seqVec(1);
+        seqVec[0] = Sequence::Info("Sequence", 1000, 0, 250);
+        ancGenome->setDimensions(seqVec);
+        seqVec[0] = Sequence::Info("Sequence", 1000, 250, 0);
+        leaf1Genome->setDimensions(seqVec);
+        leaf2Genome->setDimensions(seqVec);
+        _string = randomString(1000);
+        ancGenome->setString(_string);
+
+        BottomSegmentIteratorPtr botIt = ancGenome->getBottomSegmentIterator();
+        for (hal_index_t i = 0; i < 250; ++i, botIt->toRight()) {
+            botIt->setCoordinates(i * 4, 4);
+            botIt->bseg()->setChildIndex(0, i);
+            botIt->bseg()->setChildReversed(0, i % 2 == 0);
+            botIt->bseg()->setChildIndex(1, 249 - i);
+            botIt->bseg()->setChildReversed(1, i % 3 == 0);
+            botIt->bseg()->setTopParseIndex(NULL_INDEX);
+        }
+        TopSegmentIteratorPtr topIt = leaf1Genome->getTopSegmentIterator();
+        for (hal_index_t i = 0; i < 250; ++i, topIt->toRight()) {
+            topIt->setCoordinates(i * 4, 4);
+            topIt->tseg()->setParentIndex(249 - i);
+            topIt->tseg()->setParentReversed(i % 2 == 1);
+            topIt->tseg()->setBottomParseIndex(NULL_INDEX);
+            topIt->tseg()->setNextParalogyIndex(i % 5 == 0 ? i + 1 : NULL_INDEX);
+        }
+
+        // copy Leaf1 to Leaf2 in blocks that don't divide the array evenly
+        SegmentBlock block;
+        for (hal_index_t first = 0; first < 250; first += 17) {
+            leaf1Genome->getSegmentBlock(true, first, min(hal_index_t(17), 250 - first), block);
+            leaf2Genome->setSegmentBlock(true, block);
+        }
+        // swap the children of some ancestral segments
+        ancGenome->getSegmentBlock(false, 100, 50, block);
+        CuAssertTrue(_testCase, block._numChildren == 2 && block.getNumSegments() == 50);
+        for (hal_size_t i = 0; i < 50; ++i) {
+            swap(block._linkIndexes[i * 2], block._linkIndexes[i * 2 + 1]);
+            swap(block._reversed[i * 2], block._reversed[i * 2 + 1]);
+        }
+        ancGenome->setSegmentBlock(false, block);
+    }
+
+    void checkCallBack(AlignmentConstPtr alignment) {
+        const Genome *ancGenome = alignment->openGenome("AncGenome");
+        const Genome *leaf1Genome = alignment->openGenome("Leaf1");
+        const Genome *leaf2Genome = alignment->openGenome("Leaf2");
+        TopSegmentIteratorPtr topIt1 = leaf1Genome->getTopSegmentIterator();
+        TopSegmentIteratorPtr topIt2 = leaf2Genome->getTopSegmentIterator();
+        for (hal_index_t i = 0; i < 250; ++i, topIt1->toRight(), topIt2->toRight()) {
+            CuAssertTrue(_testCase, topIt2->getStartPosition() == i * 4 && topIt2->getLength() == 4);
+            CuAssertTrue(_testCase, topIt2->tseg()->getParentIndex() == topIt1->tseg()->getParentIndex());
+            CuAssertTrue(_testCase, topIt2->tseg()->getParentReversed() == topIt1->tseg()->getParentReversed());
+            CuAssertTrue(_testCase, topIt2->tseg()->getBottomParseIndex() == NULL_INDEX);
+            CuAssertTrue(_testCase, topIt2->tseg()->getNextParalogyIndex() == topIt1->tseg()->getNextParalogyIndex());
+        }
+        BottomSegmentIteratorPtr botIt = ancGenome->getBottomSegmentIterator();
+        for (hal_index_t i = 0; i < 250; ++i, botIt->toRight()) {
+            bool swapped = i >= 100 && i < 150;
+            CuAssertTrue(_testCase, botIt->getStartPosition() == i * 4 && botIt->getLength() == 4);
+            CuAssertTrue(_testCase, botIt->bseg()->getChildIndex(swapped ? 1 : 0) == i);
+            CuAssertTrue(_testCase, botIt->bseg()->getChildIndex(swapped ? 0 : 1) == 249 - i);
+            CuAssertTrue(_testCase, botIt->bseg()->getChildReversed(swapped ? 1 : 0) == (i % 2 == 0));
+            CuAssertTrue(_testCase, botIt->bseg()->getChildReversed(swapped ? 0 : 1) == (i % 3 == 0));
+        }
+        SegmentBlock block;
+        ancGenome->getSegmentBlock(false, 240, 10, block);
+        CuAssertTrue(_testCase, block._first == 240 && block._startPositions[10] == 1000);
+        CuAssertTrue(_testCase, block._linkIndexes[18] == 249 && block._parseIndexes[9] == NULL_INDEX);
+
+        DnaIteratorPtr dnaIt = ancGenome->getDnaIterator(599);
+        dnaIt->toReverse();
+        string reversed;
+        dnaIt->readString(reversed, 100);
+        string expected = _string.substr(500, 100);
+        reverseComplement(expected);
+        CuAssertTrue(_testCase, reversed == expected && dnaIt->getArrayIndex() == 499);
+    }
+};
+
 static void halGenomeCopySegmentsWhenSequencesOutOfOrderTest(CuTest *testCase) {
     GenomeCopySegmentsWhenSequencesOutOfOrderTest tester;
     tester.check(testCase);
@@ -556,11 +696,430 @@ static void halGenomeStringTest(CuTest *testCase) {
     tester.check(testCase);
 }
 
+static void halGenomeDnaIteratorsTest(CuTest *testCase) {
+    GenomeDnaIteratorsTest tester;
+    tester.check(testCase);
+}
+
 static void halGenomeCopyTest(CuTest *testCase) {
     GenomeCopyTest tester;
     tester.check(testCase);
 }
 
+static void halGenomeSegmentBlockTest(CuTest *testCase) {
+    GenomeSegmentBlockTest tester;
+    tester.check(testCase);
+}
+
+/* create an mmap file much smaller than its contents, forcing it to
+ * grow while genomes are being written */
+static void halGenomeMMapGrowTest(CuTest *testCase) {
+    string path = getTempFile();
+    try {
+        string dna = AlignmentTest::randomString(3000000);
+        AlignmentPtr calignment(mmapAlignmentInstance(path, CREATE_ACCESS, 64 * 1024));
+        Genome *ancGenome = calignment->addRootGenome("AncGenome", 0);
+        vector<Sequence::Info> seqVec(1);
+        seqVec[0] = Sequence::Info("Sequence", dna.size(), 0, 700000);
+        ancGenome->setDimensions(seqVec);
+        ancGenome->setString(dna);
+        Genome *leafGenome = calignment->addLeafGenome("Leaf", "AncGenome", 0.1);
+        seqVec[0] = Sequence::Info("Sequence", dna.size(), 700000, 0);
+        leafGenome->setDimensions(seqVec);
+        leafGenome->setString(dna);
+        calignment->close();
+
+        AlignmentPtr ralignment(mmapAlignmentInstance(path, READ_ACCESS));
+        const Genome *checkGenome = ralignment->openGenome("AncGenome");
+        CuAssertTrue(testCase, checkGenome->getNumBottomSegments() == 700000);
+        string genomeString;
+        checkGenome->getString(genomeString);
+        CuAssertTrue(testCase, genomeString == dna);
+        checkGenome = ralignment->openGenome("Leaf");
+        CuAssertTrue(testCase, checkGenome->getNumTopSegments() == 700000);
+        checkGenome->getString(genomeString);
+        CuAssertTrue(testCase, genomeString == dna);
+        ralignment->close();
+    } catch (const exception &e) {
+        CuFail(testCase, stString_print("Caught exception while testing: %s", e.what()));
+    }
+    remove(path.c_str());
+}
+
+/* write DNA compressed in blocks, read it back, including across block
+ * boundaries, then update it in place */
+static void halGenomeMMapCompressedDnaTest(CuTest *testCase) {
+    const hal_size_t blockSize = 64 * 1024; // bases per compressed block
+    string path = getTempFile();
+    try {
+        string dna = AlignmentTest::randomString(3 * blockSize + 101);
+        AlignmentPtr calignment(mmapAlignmentInstance(path, CREATE_ACCESS, MMAP_DEFAULT_FILE_SIZE, MMAP_DNA_COMPRESSED));
+        Genome *ancGenome = calignment->addRootGenome("AncGenome", 0);
+        vector<Sequence::Info> seqVec(1);
+        seqVec[0] = Sequence::Info("Sequence", dna.size(), 0, 1000);
+        ancGenome->setDimensions(seqVec);
+        ancGenome->setString(dna);
+        string genomeString;
+        ancGenome->getString(genomeString);
+        CuAssertTrue(testCase, genomeString == dna);
+        calignment->close();
+
+        AlignmentPtr ralignment(mmapAlignmentInstance(path, READ_ACCESS));
+        const Genome *checkGenome = ralignment->openGenome("AncGenome");
+        checkGenome->getString(genomeString);
+        CuAssertTrue(testCase, genomeString == dna);
+        checkGenome->getSubString(genomeString, blockSize - 3, 7);
+        CuAssertTrue(testCase, genomeString == dna.substr(blockSize - 3, 7));
+        checkGenome->getSubString(genomeString, dna.size() - 5, 5);
+        CuAssertTrue(testCase, genomeString == dna.substr(dna.size() - 5, 5));
+        ralignment->close();
+
+        AlignmentPtr walignment(mmapAlignmentInstance(path, READ_ACCESS | WRITE_ACCESS));
+        Genome *updateGenome = walignment->openGenome("AncGenome");
+        string update = AlignmentTest::randomString(1001);
+        updateGenome->setSubString(update, 2 * blockSize - 500, update.size());
+        dna.replace(2 * blockSize - 500, update.size(), update);
+        walignment->close();
+
+        ralignment = AlignmentPtr(mmapAlignmentInstance(path, READ_ACCESS));
+        checkGenome = ralignment->openGenome("AncGenome");
+        checkGenome->getString(genomeString);
+        CuAssertTrue(testCase, genomeString == dna);
+        ralignment->close();
+    } catch (const exception &e) {
+        CuFail(testCase, stString_print("Caught exception while testing: %s", e.what()));
+    }
+    remove(path.c_str());
+}
+
+/* write DNA stored as 2-bit bases with N and lower-case runs, read it back
+ * and update it in place */
+static void halGenomeMMapTwoBitDnaTest(CuTest *testCase) {
+    string path = getTempFile();
+    try {
+        string dna = AlignmentTest::randomString(10001) + string(5000, 'N') + string(3000, 'n') + string(2000, 'a') +
+                     AlignmentTest::randomString(777);
+        AlignmentPtr calignment(mmapAlignmentInstance(path, CREATE_ACCESS, MMAP_DEFAULT_FILE_SIZE, MMAP_DNA_TWOBIT));
+        Genome *ancGenome = calignment->addRootGenome("AncGenome", 0);
+        vector<Sequence::Info> seqVec(2);
+        seqVec[0] = Sequence::Info("Sequence0", 12345, 0, 1000);
+        seqVec[1] = Sequence::Info("Sequence1", dna.size() - 12345, 0, 1000);
+        ancGenome->setDimensions(seqVec);
+        ancGenome->setString(dna);
+        calignment->close();
+
+        AlignmentPtr ralignment(mmapAlignmentInstance(path, READ_ACCESS));
+        const Genome *checkGenome = ralignment->openGenome("AncGenome");
+        string genomeString;
+        checkGenome->getString(genomeString);
+        CuAssertTrue(testCase, genomeString == dna);
+        checkGenome->getSubString(genomeString, 9999, 5003);
+        CuAssertTrue(testCase, genomeString == dna.substr(9999, 5003));
+        const Sequence *sequence = checkGenome->getSequence("Sequence1");
+        sequence->getString(genomeString);
+        CuAssertTrue(testCase, genomeString == dna.substr(12345));
+        ralignment->close();
+
+        AlignmentPtr walignment(mmapAlignmentInstance(path, READ_ACCESS | WRITE_ACCESS));
+        Genome *updateGenome = walignment->openGenome("AncGenome");
+        string update = "ACGTnnNNacgtN";
+        updateGenome->setSubString(update, 14995, update.size());
+        dna.replace(14995, update.size(), update);
+        walignment->close();
+
+        ralignment = AlignmentPtr(mmapAlignmentInstance(path, READ_ACCESS));
+        checkGenome = ralignment->openGenome("AncGenome");
+        checkGenome->getString(genomeString);
+        CuAssertTrue(testCase, genomeString == dna);
+        ralignment->close();
+    } catch (const exception &e) {
+        CuFail(testCase, stString_print("Caught exception while testing: %s", e.what()));
+    }
+    remove(path.c_str());
+}
+
+/* modify the DNA and metadata of a 2-bit file, leaving space behind,
+ * then check a compacted copy is smaller and has the same contents */
+static void halGenomeMMapCompactTest(CuTest *testCase) {
+    string path = getTempFile();
+    string compactPath = getTempFile();
+    try {
+        string dna = AlignmentTest::randomString(20000);
+        AlignmentPtr calignment(mmapAlignmentInstance(path, CREATE_ACCESS, MMAP_DEFAULT_FILE_SIZE, MMAP_DNA_TWOBIT));
+        Genome *ancGenome = calignment->addRootGenome("AncGenome", 0);
+        Genome *leafGenome = calignment->addLeafGenome("Leaf", "AncGenome", 0.25);
+        vector<Sequence::Info> seqVec(1);
+        seqVec[0] = Sequence::Info("Sequence", dna.size(), 0, 100);
+        ancGenome->setDimensions(seqVec);
+        ancGenome->setString(dna);
+        seqVec[0] = Sequence::Info("Sequence", dna.size(), 100, 0);
+        leafGenome->setDimensions(seqVec);
+        leafGenome->setString(dna);
+        TopSegmentIteratorPtr ti = leafGenome->getTopSegmentIterator();
+        BottomSegmentIteratorPtr bi = ancGenome->getBottomSegmentIterator();
+        for (hal_index_t i = 0; i < 100; ++i, ti->toRight(), bi->toRight()) {
+            ti->setCoordinates(i * 200, 200);
+            ti->tseg()->setParentIndex(99 - i);
+            ti->tseg()->setParentReversed(true);
+            ti->tseg()->setNextParalogyIndex(NULL_INDEX);
+            ti->tseg()->setBottomParseIndex(NULL_INDEX);
+            bi->setCoordinates(i * 200, 200);
+            bi->bseg()->setChildIndex(0, 99 - i);
+            bi->bseg()->setChildReversed(0, true);
+            bi->bseg()->setTopParseIndex(NULL_INDEX);
+        }
+        calignment->close();
+
+        AlignmentPtr walignment(mmapAlignmentInstance(path, READ_ACCESS | WRITE_ACCESS));
+        Genome *updateGenome = walignment->openGenome("Leaf");
+        string update = "ACGTnnNNacgtN";
+        updateGenome->setSubString(update, 1000, update.size());
+        dna.replace(1000, update.size(), update);
+        updateGenome->getMetaData()->set("key", "value");
+        walignment->close();
+
+        mmapCompactAlignment(path, compactPath);
+        struct stat oldStat, newStat;
+        stat(path.c_str(), &oldStat);
+        stat(compactPath.c_str(), &newStat);
+        CuAssertTrue(testCase, newStat.st_size < oldStat.st_size);
+
+        AlignmentPtr ralignment(mmapAlignmentInstance(compactPath, READ_ACCESS));
+        CuAssertTrue(testCase, ralignment->getBranchLength("AncGenome", "Leaf") == 0.25);
+        const Genome *checkGenome = ralignment->openGenome("Leaf");
+        string genomeString;
+        checkGenome->getString(genomeString);
+        CuAssertTrue(testCase, genomeString == dna);
+        CuAssertTrue(testCase, checkGenome->getMetaData()->get("key") == "value");
+        TopSegmentIteratorPtr checkTop = checkGenome->getTopSegmentIterator(42);
+        CuAssertTrue(testCase, checkTop->getStartPosition() == 42 * 200);
+        CuAssertTrue(testCase, checkTop->tseg()->getParentIndex() == 99 - 42);
+        CuAssertTrue(testCase, checkTop->tseg()->getParentReversed());
+        BottomSegmentIteratorPtr checkBottom = ralignment->openGenome("AncGenome")->getBottomSegmentIterator(17);
+        CuAssertTrue(testCase, checkBottom->getLength() == 200);
+        CuAssertTrue(testCase, checkBottom->bseg()->getChildIndex(0) == 99 - 17);
+        ralignment->close();
+    } catch (const exception &e) {
+        CuFail(testCase, stString_print("Caught exception while testing: %s", e.what()));
+    }
+    remove(path.c_str());
+    remove(compactPath.c_str());
+}
+
+/* open an mmap file copied into memory with --mmapInMemory */
+static void halGenomeMMapInMemoryTest(CuTest *testCase) {
+    string path = getTempFile();
+    try {
+        string dna = AlignmentTest::randomString(100001);
+        AlignmentPtr calignment(mmapAlignmentInstance(path, CREATE_ACCESS));
+        Genome *ancGenome = calignment->addRootGenome("AncGenome", 0);
+        vector<Sequence::Info> seqVec(1);
+        seqVec[0] = Sequence::Info("Sequence", dna.size(), 0, 1000);
+        ancGenome->setDimensions(seqVec);
+        ancGenome->setString(dna);
+        calignment->close();
+
+        CLParser optionsParser;
+        const char *argv[] = {"halGenomeTest", "--mmapInMemory"};
+        optionsParser.parseOptions(2, const_cast<char **>(argv));
+        AlignmentConstPtr ralignment(openHalAlignment(path, &optionsParser));
+        const Genome *checkGenome = ralignment->openGenome("AncGenome");
+        CuAssertTrue(testCase, checkGenome->getNumBottomSegments() == 1000);
+        string genomeString;
+        checkGenome->getString(genomeString);
+        CuAssertTrue(testCase, genomeString == dna);
+        ralignment->close();
+    } catch (const exception &e) {
+        CuFail(testCase, stString_print("Caught exception while testing: %s", e.what()));
+    }
+    remove(path.c_str());
+}
+
+/* block tracking, coalescing and read-ahead of MMapPrefetcher, with fetches
+ * copying from a string standing in for a remote file */
+static void halGenomeMMapPrefetcherTest(CuTest *testCase) {
+    const size_t blockSize = 16, readAheadBlocks = 8;
+    string remote = AlignmentTest::randomString(100 * blockSize + 5);
+    string local(remote.size(), '\0');
+    vector<pair<size_t, size_t>> fetches;
+    auto copyRange = [&](size_t offset, size_t length) { local.replace(offset, length, remote, offset, length); };
+    MMapPrefetcher prefetcher(
+        remote.size(), blockSize,
+        [&](size_t offset, size_t length) {
+            fetches.push_back(make_pair(offset, length));
+            copyRange(offset, length);
+        },
+        copyRange, readAheadBlocks);
+
+    // fetched blocks are not fetched again, adjacent missing blocks are merged
+    prefetcher.fetch(40, 8);
+    prefetcher.fetch(34, 10);
+    prefetcher.fetch(100, 60);
+    CuAssertTrue(testCase, fetches.size() == 2);
+    CuAssertTrue(testCase, fetches[0] == make_pair(size_t(32), blockSize));
+    CuAssertTrue(testCase, fetches[1] == make_pair(6 * blockSize, 4 * blockSize));
+
+    // a sequential miss reads ahead, and reaching the read-ahead reads ahead again
+    prefetcher.fetch(10 * blockSize, 1);
+    prefetcher.waitForReadAhead();
+    prefetcher.fetch(11 * blockSize, readAheadBlocks * blockSize);
+    prefetcher.waitForReadAhead();
+    prefetcher.fetch((11 + readAheadBlocks) * blockSize, readAheadBlocks * blockSize);
+    CuAssertTrue(testCase, prefetcher.getNumFetches() == 3);
+    CuAssertTrue(testCase, remote.compare(6 * blockSize, (5 + 2 * readAheadBlocks) * blockSize, local,
+                                          6 * blockSize, (5 + 2 * readAheadBlocks) * blockSize) == 0);
+
+    // the last block is clipped to the file size
+    prefetcher.fetch(remote.size() - 1, 100);
+    CuAssertTrue(testCase, fetches.back() == make_pair(100 * blockSize, size_t(5)));
+    CuAssertTrue(testCase, remote.compare(100 * blockSize, 5, local, 100 * blockSize, 5) == 0);
+}
+
+/* read DNA and sequences from several threads at once with --hdf5Concurrent */
+static void halGenomeHdf5ConcurrentTest(CuTest *testCase) {
+    string path = getTempFile();
+    try {
+        vector<string> dnas = {AlignmentTest::randomString(300007), AlignmentTest::randomString(200003)};
+        AlignmentPtr calignment(hdf5AlignmentInstance(path, CREATE_ACCESS, hdf5DefaultFileCreatPropList(),
+                                                      hdf5DefaultFileAccPropList(), hdf5DefaultDSetCreatPropList()));
+        Genome *ancGenome = calignment->addRootGenome("AncGenome", 0);
+        Genome *leafGenome = calignment->addLeafGenome("LeafGenome", "AncGenome", 0.1);
+        vector<Sequence::Info> seqVec(2);
+        seqVec[0] = Sequence::Info("Sequence0", 100000, 0, 100);
+        seqVec[1] = Sequence::Info("Sequence1", dnas[0].size() - 100000, 0, 100);
+        ancGenome->setDimensions(seqVec);
+        ancGenome->setString(dnas[0]);
+        seqVec[0] = Sequence::Info("Sequence0", dnas[1].size(), 100, 0);
+        seqVec.resize(1);
+        leafGenome->setDimensions(seqVec);
+        leafGenome->setString(dnas[1]);
+        for (TopSegmentIteratorPtr ti = leafGenome->getTopSegmentIterator(); not ti->atEnd(); ti->toRight()) {
+            ti->tseg()->setParentIndex(ti->getArrayIndex() * 3);
+        }
+        calignment->close();
+
+        CLParser optionsParser;
+        const char *argv[] = {"halGenomeTest", "--hdf5Concurrent"};
+        optionsParser.parseOptions(2, const_cast<char **>(argv));
+        AlignmentConstPtr ralignment(openHalAlignment(path, &optionsParser));
+        vector<const Genome *> genomes = {ralignment->openGenome("AncGenome"), ralignment->openGenome("LeafGenome")};
+        const size_t numThreads = 4;
+        vector<char> threadOk(numThreads, true);
+        vector<thread> threads;
+        for (size_t t = 0; t < numThreads; ++t) {
+            threads.push_back(thread([&, t]() {
+                hal_index_t pos = t * 7919;
+                for (size_t i = 0; i < 2000 && threadOk[t]; ++i) {
+                    size_t g = (t + i) % 2;
+                    pos = (pos + 104729) % (dnas[g].size() - 50);
+                    string substring;
+                    genomes[g]->getSubString(substring, pos, 50);
+                    const Sequence *sequence = genomes[g]->getSequenceBySite(pos);
+                    TopSegmentIteratorPtr ti = genomes[1]->getTopSegmentIterator(pos % 100);
+                    threadOk[t] = ti->tseg()->getParentIndex() == (pos % 100) * 3 && substring == dnas[g].substr(pos, 50) && sequence != NULL &&
+                                  sequence->getStartPosition() <= pos &&
+                                  pos < sequence->getStartPosition() + (hal_index_t)sequence->getSequenceLength() &&
+                                  genomes[0]->getChild(0) == genomes[1] && genomes[1]->getParent() == genomes[0];
+                }
+            }));
+        }
+        for (size_t t = 0; t < numThreads; ++t) {
+            threads[t].join();
+            CuAssertTrue(testCase, threadOk[t]);
+        }
+        ralignment->close();
+    } catch (const exception &e) {
+        CuFail(testCase, stString_print("Caught exception while testing: %s", e.what()));
+    }
+    remove(path.c_str());
+}
+
+/* size chunk caches from --hdf5CacheBudget and count reads through the arrays */
+static void halGenomeHdf5CacheBudgetTest(CuTest *testCase) {
+    string path = getTempFile();
+    try {
+        string dna = AlignmentTest::randomString(300007);
+        AlignmentPtr calignment(hdf5AlignmentInstance(path, CREATE_ACCESS, hdf5DefaultFileCreatPropList(),
+                                                      hdf5DefaultFileAccPropList(), hdf5DefaultDSetCreatPropList()));
+        Genome *ancGenome = calignment->addRootGenome("AncGenome", 0);
+        vector<Sequence::Info> seqVec(1);
+        seqVec[0] = Sequence::Info("Sequence", dna.size(), 0, 1000);
+        ancGenome->setDimensions(seqVec);
+        ancGenome->setString(dna);
+        calignment->close();
+
+        const hsize_t budget = 100000;
+        const char *budgetArgv[] = {"halGenomeTest", "--hdf5CacheBudget", "100000"};
+        const char *bytesArgv[] = {"halGenomeTest", "--hdf5CacheBytes", "100000"};
+        for (const char **argv : {budgetArgv, bytesArgv}) {
+            CLParser optionsParser;
+            optionsParser.parseOptions(3, const_cast<char **>(argv));
+            AlignmentConstPtr ralignment(openHalAlignment(path, &optionsParser));
+            const Genome *checkGenome = ralignment->openGenome("AncGenome");
+            string genomeString;
+            checkGenome->getString(genomeString);
+            CuAssertTrue(testCase, genomeString == dna);
+            CuAssertTrue(testCase, checkGenome->getBottomSegmentIterator(500)->bseg()->getStartPosition() == 0);
+            Hdf5CacheStats stats = dynamic_cast<const Hdf5Alignment *>(ralignment.get())->getCacheStats();
+            CuAssertTrue(testCase, stats._numOpenGenomes == 1);
+            if (argv == budgetArgv) {
+                CuAssertTrue(testCase, stats._chunkCacheBytes > budget / 2 && stats._chunkCacheBytes <= budget);
+            } else {
+                CuAssertTrue(testCase, stats._chunkCacheBytes == 0);
+            }
+            CuAssertTrue(testCase, stats._arrays._bytesRead >= dna.size() / 2);
+            CuAssertTrue(testCase, stats._arrays._windowLoads > 0 && stats._arrays._bytesWritten == 0);
+            ralignment->close();
+        }
+    } catch (const exception &e) {
+        CuFail(testCase, stString_print("Caught exception while testing: %s", e.what()));
+    }
+    remove(path.c_str());
+}
+
+/* write with chunks compressed on several threads, including a partial
+ * last chunk and elements rewritten after their chunk was queued */
+static void halGenomeHdf5CompressionThreadsTest(CuTest *testCase) {
+    string path = getTempFile();
+    try {
+        string dna = AlignmentTest::randomString(123457);
+        const hal_size_t numSegments = 4321;
+        {
+            CLParser optionsParser(CREATE_ACCESS);
+            const char *argv[] = {"halGenomeTest", "--hdf5CompressionThreads", "3", "--hdf5Chunk", "100"};
+            optionsParser.parseOptions(5, const_cast<char **>(argv));
+            AlignmentPtr calignment(openHalAlignment(path, &optionsParser, CREATE_ACCESS));
+            Genome *ancGenome = calignment->addRootGenome("AncGenome", 0);
+            vector<Sequence::Info> seqVec(1);
+            seqVec[0] = Sequence::Info("Sequence", dna.size(), 0, numSegments);
+            ancGenome->setDimensions(seqVec);
+            ancGenome->setString(dna);
+            for (BottomSegmentIteratorPtr bi = ancGenome->getBottomSegmentIterator(); not bi->atEnd(); bi->toRight()) {
+                bi->bseg()->setTopParseIndex(bi->getArrayIndex() * 7);
+            }
+            BottomSegmentIteratorPtr bi = ancGenome->getBottomSegmentIterator(150);
+            bi->bseg()->setTopParseIndex(1);
+            ancGenome->setSubString("ACGT", 1000, 4);
+            dna.replace(1000, 4, "ACGT");
+            calignment->close();
+        }
+        AlignmentConstPtr ralignment(openHalAlignment(path, NULL));
+        const Genome *checkGenome = ralignment->openGenome("AncGenome");
+        string genomeString;
+        checkGenome->getString(genomeString);
+        CuAssertTrue(testCase, genomeString == dna);
+        CuAssertTrue(testCase, checkGenome->getNumBottomSegments() == numSegments);
+        for (BottomSegmentIteratorPtr bi = checkGenome->getBottomSegmentIterator(); not bi->atEnd(); bi->toRight()) {
+            hal_index_t i = bi->getArrayIndex();
+            CuAssertTrue(testCase, bi->bseg()->getTopParseIndex() == (i == 150 ? 1 : i * 7));
+        }
+        ralignment->close();
+    } catch (const exception &e) {
+        CuFail(testCase, stString_print("Caught exception while testing: %s", e.what()));
+    }
+    remove(path.c_str());
+}
+
 static void halGenomeDNAPackUnpackTest(CuTest *testCase) {
     const char *DNA = "CCTTTTGAGAATTGATGGTGTGGATAAAGCCTTTCATTCATAAACACTCAAGGTACCACACTGTAAAAGGGTCAGTAAGT";
     char packed[strlen(DNA)];
@@ -578,8 +1137,19 @@ static CuSuite *halGenomeTestSuite(void) {
     SUITE_ADD_TEST(suite, halGenomeCreateTest);
     SUITE_ADD_TEST(suite, halGenomeUpdateTest);
     SUITE_ADD_TEST(suite, halGenomeStringTest);
+    SUITE_ADD_TEST(suite, halGenomeDnaIteratorsTest);
     SUITE_ADD_TEST(suite, halGenomeCopyTest);
+    SUITE_ADD_TEST(suite, halGenomeSegmentBlockTest);
     SUITE_ADD_TEST(suite, halGenomeCopySegmentsWhenSequencesOutOfOrderTest);
+    SUITE_ADD_TEST(suite, halGenomeMMapGrowTest);
+    SUITE_ADD_TEST(suite, halGenomeMMapCompressedDnaTest);
+    SUITE_ADD_TEST(suite, halGenomeMMapTwoBitDnaTest);
+    SUITE_ADD_TEST(suite, halGenomeMMapCompactTest);
+    SUITE_ADD_TEST(suite, halGenomeMMapInMemoryTest);
+    SUITE_ADD_TEST(suite, halGenomeMMapPrefetcherTest);
+    SUITE_ADD_TEST(suite, halGenomeHdf5ConcurrentTest);
+    SUITE_ADD_TEST(suite, halGenomeHdf5CacheBudgetTest);
+    SUITE_ADD_TEST(suite, halGenomeHdf5CompressionThreadsTest);
     SUITE_ADD_TEST(suite, halGenomeDNAPackUnpackTest);
     return suite;
 }
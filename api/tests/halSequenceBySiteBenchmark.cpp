@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+/* Microbenchmark of Genome::getSequenceBySite() lookups at random
+ * positions, or Genome::getSequence() lookups of random names,
+ * optionally creating a genome with many sequences first. */
+
+#include "halAlignmentInstance.h"
+#include "halCLParser.h"
+#include "halGenome.h"
+#include "halSequence.h"
+#include "halSequenceIterator.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace hal;
+
+/* create a root genome of numSequences random-length sequences */
+static void createGenome(const string &path, const string &genomeName, hal_size_t numSequences, mt19937_64 &rng) {
+    AlignmentPtr alignment(mmapAlignmentInstance(path, CREATE_ACCESS));
+    Genome *genome = alignment->addRootGenome(genomeName, 0);
+    uniform_int_distribution<hal_size_t> lengthDist(1, 2000);
+    vector<Sequence::Info> seqVec;
+    for (hal_size_t i = 0; i < numSequences; ++i) {
+        seqVec.push_back(Sequence::Info("sequence" + std::to_string(i), lengthDist(rng), 0, 0));
+    }
+    genome->setDimensions(seqVec, false);
+    alignment->close();
+}
+
+int main(int argc, char **argv) {
+    CLParser optionsParser;
+    optionsParser.setDescription("Time sequence lookups by genome position or name");
+    optionsParser.addArgument("halFile", "path to hal file");
+    optionsParser.addOption("genome", "genome to look up positions in, default is the root", "\"\"");
+    optionsParser.addOption("numSequences", "create an mmap halFile with a root genome with this many sequences", 0);
+    optionsParser.addOption("numLookups", "number of random positions to look up", 10000000);
+    optionsParser.addOption("seed", "random number seed", 0);
+    optionsParser.addOptionFlag("byName", "look up random sequence names rather than positions", false);
+    string path, genomeName;
+    hal_size_t numSequences, numLookups;
+    unsigned seed;
+    bool byName;
+    try {
+        optionsParser.parseOptions(argc, argv);
+        path = optionsParser.getArgument<string>("halFile");
+        genomeName = optionsParser.getOption<string>("genome");
+        numSequences = optionsParser.getOption<hal_size_t>("numSequences");
+        numLookups = optionsParser.getOption<hal_size_t>("numLookups");
+        seed = optionsParser.getOption<unsigned>("seed");
+        byName = optionsParser.getFlag("byName");
+    } catch (exception &e) {
+        cerr << e.what() << endl;
+        optionsParser.printUsage(cerr);
+        return 1;
+    }
+    try {
+        mt19937_64 rng(seed);
+        if (numSequences > 0) {
+            if (genomeName == "\"\"") {
+                genomeName = "Genome";
+            }
+            createGenome(path, genomeName, numSequences, rng);
+        }
+        AlignmentConstPtr alignment(openHalAlignment(path, &optionsParser));
+        if (genomeName == "\"\"") {
+            genomeName = alignment->getRootName();
+        }
+        const Genome *genome = alignment->openGenome(genomeName);
+        if (genome == NULL) {
+            throw hal_exception("Genome " + genomeName + " not found");
+        }
+        uniform_int_distribution<hal_size_t> positionDist(0, genome->getSequenceLength() - 1);
+        vector<hal_size_t> positions(numLookups);
+        for (auto &position : positions) {
+            position = positionDist(rng);
+        }
+        vector<string> names;
+        if (byName) {
+            vector<string> allNames;
+            for (SequenceIteratorPtr seqIt = genome->getSequenceIterator(); not seqIt->atEnd(); seqIt->toNext()) {
+                allNames.push_back(seqIt->getSequence()->getName());
+            }
+            uniform_int_distribution<size_t> nameDist(0, allNames.size() - 1);
+            for (hal_size_t i = 0; i < numLookups; ++i) {
+                names.push_back(allNames[nameDist(rng)]);
+            }
+        }
+
+        hal_index_t checksum = 0;
+        auto start = chrono::steady_clock::now();
+        if (byName) {
+            for (const auto &name : names) {
+                checksum += genome->getSequence(name)->getArrayIndex();
+            }
+        } else {
+            for (auto position : positions) {
+                checksum += genome->getSequenceBySite(position)->getArrayIndex();
+            }
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "sequences: " << genome->getNumSequences() << " lookups: " << numLookups << " seconds: " << seconds
+             << " lookups/sec: " << (numLookups / seconds) << " checksum: " << checksum << endl;
+    } catch (exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
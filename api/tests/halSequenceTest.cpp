@@ -263,11 +263,40 @@ struct SequenceRenameTest : public AlignmentTest {
     }
 };
 
+struct SequenceBySiteTest : public AlignmentTest {
+    void createCallBack(AlignmentPtr alignment) {
+        Genome *ancGenome = alignment->addRootGenome("AncGenome", 0);
+        vector<Sequence::Info> seqVec;
+        for (size_t i = 0; i < 1000; ++i) {
+            // include some empty sequences, which contain no sites
+            seqVec.push_back(Sequence::Info("sequence" + std::to_string(i), i % 7, 0, 0));
+        }
+        ancGenome->setDimensions(seqVec);
+    }
+
+    void checkCallBack(AlignmentConstPtr alignment) {
+        const Genome *ancGenome = alignment->openGenome("AncGenome");
+        for (SequenceIteratorPtr seqIt = ancGenome->getSequenceIterator(); not seqIt->atEnd(); seqIt->toNext()) {
+            const Sequence *seq = seqIt->getSequence();
+            for (hal_size_t i = 0; i < seq->getSequenceLength(); ++i) {
+                const Sequence *siteSeq = ancGenome->getSequenceBySite(seq->getStartPosition() + i);
+                CuAssertTrue(_testCase, siteSeq != NULL);
+                CuAssertTrue(_testCase, siteSeq->getName() == seq->getName());
+            }
+        }
+    }
+};
+
 static void halSequenceCreateTest(CuTest *testCase) {
     SequenceCreateTest tester;
     tester.check(testCase);
 }
 
+static void halSequenceBySiteTest(CuTest *testCase) {
+    SequenceBySiteTest tester;
+    tester.check(testCase);
+}
+
 static void halSequenceIteratorTest(CuTest *testCase) {
     SequenceIteratorTest tester;
     tester.check(testCase);
@@ -286,6 +315,7 @@ static void halSequenceRenameTest(CuTest *testCase) {
 static CuSuite *halSequenceTestSuite(void) {
     CuSuite *suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, halSequenceCreateTest);
+    SUITE_ADD_TEST(suite, halSequenceBySiteTest);
     SUITE_ADD_TEST(suite, halSequenceIteratorTest);
     SUITE_ADD_TEST(suite, halSequenceUpdateTest);
     SUITE_ADD_TEST(suite, halSequenceRenameTest);
@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+
+# Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+#
+#Released under the MIT license, see LICENSE.txt
+
+"""Compare file size and hal2fasta time for mmap HAL files with plain
+DNA against ones created with --mmapCompressDna or --mmapTwoBitDna."""
+
+import argparse
+import os
+import sys
+import time
+import random
+
+from sonLib.bioio import getTempDirectory
+from sonLib.bioio import getTempFile
+from sonLib.bioio import system
+
+dnaStorageOptions = [("nibble", ""), ("compressed", "--mmapCompressDna"), ("twobit", "--mmapTwoBitDna")]
+
+def runHalGen(preset, seed, dnaOption, outPath):
+    system("halRandGen --format mmap --preset %s --seed %d %s %s" % (
+        preset, seed, dnaOption, outPath))
+
+def runHal2Fasta(halPath, outPath):
+    system("hal2fasta %s $(halStats --root %s) --subtree --outFaPath %s" % (
+        halPath, halPath, outPath))
+
+def main(argv=None):
+    if argv is None:
+        argv = sys.argv
+
+    parser = argparse.ArgumentParser(description='Benchmark DNA storage in mmap files')
+    parser.add_argument('--preset', type=str,
+                        help='halRandGen preset to use [small, medium, big, large]', default='medium')
+    parser.add_argument('--reps', type=int, help='repetitions of each case', default=3)
+    args = parser.parse_args()
+    seed = random.randint(0, 2**31)
+    tempDir = getTempDirectory(rootDir="./")
+    faFile = getTempFile(suffix=".fa", rootDir=tempDir)
+    print("storage, rep, time(gen), fsize(k), time(hal2fasta)")
+    for rep in range(args.reps):
+        for dnaStorage, dnaOption in dnaStorageOptions:
+            tempFile = getTempFile(suffix=".hal", rootDir=tempDir)
+            t = time.time()
+            runHalGen(args.preset, seed, dnaOption, tempFile)
+            th = time.time() - t
+            t = time.time()
+            runHal2Fasta(tempFile, faFile)
+            tf = time.time() - t
+            print("%s, %d, %.3f, %.2f, %.3f" % (dnaStorage, rep, th, os.path.getsize(tempFile) / 1024., tf))
+            os.remove(tempFile)
+    system("rm -rf %s" % tempDir)
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
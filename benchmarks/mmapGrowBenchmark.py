@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+
+# Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+#
+#Released under the MIT license, see LICENSE.txt
+
+"""Compare mmap HAL creation time for a file that starts empty and grows
+on demand against one pre-sized with --mmapFileSize."""
+
+import argparse
+import os
+import sys
+import time
+import random
+
+from sonLib.bioio import getTempDirectory
+from sonLib.bioio import getTempFile
+from sonLib.bioio import system
+
+def runHalGen(preset, seed, fileSizeGb, outPath):
+    system("halRandGen --format mmap --preset %s --seed %d --mmapFileSize %d %s" % (
+        preset, seed, fileSizeGb, outPath))
+
+def main(argv=None):
+    if argv is None:
+        argv = sys.argv
+
+    parser = argparse.ArgumentParser(description='Benchmark growable mmap files')
+    parser.add_argument('--preset', type=str,
+                        help='halRandGen preset to use [small, medium, big, large]', default='medium')
+    parser.add_argument('--reps', type=int, help='repetitions of each case', default=3)
+    parser.add_argument('--presize', type=int, help='pre-sized file size in gigabytes', default=64)
+    args = parser.parse_args()
+    seed = random.randint(0, 2**31)
+    tempDir = getTempDirectory(rootDir="./")
+    print("initSize(g), rep, time(gen), fsize(k)")
+    for rep in range(args.reps):
+        for fileSizeGb in [0, args.presize]:
+            tempFile = getTempFile(suffix=".hal", rootDir=tempDir)
+            t = time.time()
+            runHalGen(args.preset, seed, fileSizeGb, tempFile)
+            th = time.time() - t
+            print("%d, %d, %.3f, %.2f" % (fileSizeGb, rep, th, os.path.getsize(tempFile) / 1024.))
+            os.remove(tempFile)
+    system("rm -rf %s" % tempDir)
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
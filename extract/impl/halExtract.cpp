@@ -1,30 +1,42 @@
-/*
- * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
- * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
- *
- * Released under the MIT license, see LICENSE.txt
- */
-
 #include "hal.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <cstdlib>
+#include <deque>
+#include <future>
+#include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
 using namespace std;
 using namespace hal;
 
+/* Genomes are copied in blocks of bases and segments, which are multiples
+ * of the default HDF5 chunk sizes so that blocks written to HDF5 fill whole
+ * chunks.  Each genome being copied holds at most QueueBlocks blocks
+ * between reading and writing. */
+static const hal_size_t DnaBlockLength = 4000000;
+static const hal_size_t SegmentBlockSize = 100000;
+static const size_t QueueBlocks = 4;
+
 static void getDimensions(AlignmentConstPtr outAlignment, const Genome *genome, vector<Sequence::Info> &dimensions);
 
-static void copyGenome(const Genome *inGenome, Genome *outGenome);
+static size_t copyGenome(const Genome *inGenome, Genome *outGenome);
 
 static void extractTree(AlignmentConstPtr inAlignment, AlignmentPtr outAlignment, const string &rootName);
 
-static void extract(AlignmentConstPtr inAlignment, AlignmentPtr outAlignment, const string &rootName);
+static void extract(AlignmentConstPtr inAlignment, AlignmentPtr outAlignment, const string &rootName, size_t numThreads);
 
 static void initParser(CLParser &optionsParser) {
     optionsParser.addArgument("inHalPath", "input hal file");
     optionsParser.addArgument("outHalPath", "output hal file");
     optionsParser.addOption("outputFormat", "format for output hal file (same as input file by default)", "");
     optionsParser.addOption("root", "root of subtree to extract", "\"\"");
+    optionsParser.addOption("numThreads", "number of genomes to copy at once, 0 for one per core", 0);
 }
 
 int main(int argc, char **argv) {
@@ -35,12 +47,14 @@ int main(int argc, char **argv) {
     string outHalPath;
     string rootName;
     string outputFormat;
+    size_t numThreads;
     try {
         optionsParser.parseOptions(argc, argv);
         inHalPath = optionsParser.getArgument<string>("inHalPath");
         outHalPath = optionsParser.getArgument<string>("outHalPath");
         rootName = optionsParser.getOption<string>("root");
         outputFormat = optionsParser.getOption<string>("outputFormat");
+        numThreads = optionsParser.getOption<size_t>("numThreads");
     } catch (exception &e) {
         cerr << e.what() << endl;
         optionsParser.printUsage(cerr);
@@ -52,6 +66,7 @@ int main(int argc, char **argv) {
         if (inAlignment->getNumGenomes() == 0) {
             throw hal_exception("input hal alignmenet is empty");
         }
+        inAlignment->setAccessPattern(ACCESS_SEQUENTIAL);
 
         if (outputFormat.empty()) {
             // No alignment format specified, just use the same as the input format.
@@ -68,8 +83,16 @@ int main(int argc, char **argv) {
             rootName = inAlignment->getRootName();
         }
 
+        if (numThreads == 0) {
+            numThreads = max(thread::hardware_concurrency(), 1u);
+        }
+        if (isUrl(inHalPath)) {
+            // remote files are fetched from one thread
+            numThreads = 1;
+        }
+
         extractTree(inAlignment, outAlignment, rootName);
-        extract(inAlignment, outAlignment, rootName);
+        extract(inAlignment, outAlignment, rootName, numThreads);
         outAlignment->close();
     } catch (hal_exception &e) {
         cerr << "hal exception caught: " << e.what() << endl;
@@ -95,52 +118,150 @@ void getDimensions(AlignmentConstPtr outAlignment, const Genome *genome, vector<
     }
 }
 
-void copyGenome(const Genome *inGenome, Genome *outGenome) {
-    DnaIteratorPtr inDna = inGenome->getDnaIterator();
-    DnaIteratorPtr outDna = outGenome->getDnaIterator();
-    hal_size_t n = inGenome->getSequenceLength();
-    assert(n == outGenome->getSequenceLength());
-    for (; (hal_size_t)inDna->getArrayIndex() < n; inDna->toRight(), outDna->toRight()) {
-        outDna->setBase(inDna->getBase());
-    }
-    outDna->flush();
-
-    TopSegmentIteratorPtr inTop = inGenome->getTopSegmentIterator();
-    TopSegmentIteratorPtr outTop = outGenome->getTopSegmentIterator();
-    n = outGenome->getNumTopSegments();
-    assert(n == 0 || n == inGenome->getNumTopSegments());
-    for (; (hal_size_t)inTop->getArrayIndex() < n; inTop->toRight(), outTop->toRight()) {
-        outTop->setCoordinates(inTop->getStartPosition(), inTop->getLength());
-        outTop->tseg()->setParentIndex(inTop->tseg()->getParentIndex());
-        outTop->tseg()->setParentReversed(inTop->tseg()->getParentReversed());
-        outTop->tseg()->setBottomParseIndex(inTop->tseg()->getBottomParseIndex());
-        outTop->tseg()->setNextParalogyIndex(inTop->tseg()->getNextParalogyIndex());
-    }
-
-    BottomSegmentIteratorPtr inBot = inGenome->getBottomSegmentIterator();
-    BottomSegmentIteratorPtr outBot = outGenome->getBottomSegmentIterator();
-    n = outGenome->getNumBottomSegments();
-    assert(n == 0 || n == inGenome->getNumBottomSegments());
-    hal_size_t nc = inGenome->getNumChildren();
-    assert(nc == outGenome->getNumChildren());
-    for (; (hal_size_t)inBot->getArrayIndex() < n; inBot->toRight(), outBot->toRight()) {
-        outBot->setCoordinates(inBot->getStartPosition(), inBot->getLength());
-        for (hal_size_t child = 0; child < nc; ++child) {
-            outBot->bseg()->setChildIndex(child, inBot->bseg()->getChildIndex(child));
-            outBot->bseg()->setChildReversed(child, inBot->bseg()->getChildReversed(child));
-        }
-        if (outGenome->getAlignment()->getRootName() == outGenome->getName()) {
-            outBot->bseg()->setTopParseIndex(NULL_INDEX);
-        } else {
-            outBot->bseg()->setTopParseIndex(inBot->bseg()->getTopParseIndex());
-        }
-    }
-
-    const map<string, string> &meta = inGenome->getMetaData()->getMap();
-    map<string, string>::const_iterator i = meta.begin();
-    for (; i != meta.end(); ++i) {
-        outGenome->getMetaData()->set(i->first, i->second);
+/* bases or segments read from one genome, to be written to its copy */
+struct CopyBlock {
+    enum Type { DNA, TOP, BOTTOM };
+    Type _type;
+    hal_index_t _start; // first base of DNA
+    string _dna;
+    SegmentBlock _segments;
+};
+
+/* Bounded queue of blocks from the thread reading a genome to the thread
+ * writing its copy.  Closing the queue stops both threads. */
+class BlockQueue {
+  public:
+    BlockQueue(size_t capacity) : _capacity(capacity), _closed(false) {
+    }
+
+    /* add a block, waiting for room, returning false if the queue is closed */
+    bool push(CopyBlock &block) {
+        unique_lock<mutex> lock(_mutex);
+        _changed.wait(lock, [this] { return _closed or (_blocks.size() < _capacity); });
+        if (_closed) {
+            return false;
+        }
+        _blocks.push_back(move(block));
+        _changed.notify_all();
+        return true;
+    }
+
+    /* take the next block, waiting for one, returning false once the
+     * queue is closed and empty */
+    bool pop(CopyBlock &block) {
+        unique_lock<mutex> lock(_mutex);
+        _changed.wait(lock, [this] { return _closed or not _blocks.empty(); });
+        if (_blocks.empty()) {
+            return false;
+        }
+        block = move(_blocks.front());
+        _blocks.pop_front();
+        _changed.notify_all();
+        return true;
+    }
+
+    void close() {
+        lock_guard<mutex> guard(_mutex);
+        _closed = true;
+        _changed.notify_all();
+    }
+
+  private:
+    size_t _capacity;
+    bool _closed;
+    deque<CopyBlock> _blocks;
+    mutex _mutex;
+    condition_variable _changed;
+};
+
+/* Read the blocks of a genome to copy, numTop and numBottom being the
+ * number of segments in the copy.  The top parse indexes are dropped if
+ * the copy is a root. */
+static void readGenome(const Genome *inGenome, hal_size_t numTop, hal_size_t numBottom, bool outRoot, BlockQueue &queue) {
+    CopyBlock block;
+    hal_size_t length = inGenome->getSequenceLength();
+    for (hal_size_t start = 0; start < length; start += DnaBlockLength) {
+        block._type = CopyBlock::DNA;
+        block._start = start;
+        inGenome->getSubString(block._dna, start, min(DnaBlockLength, length - start));
+        if (not queue.push(block)) {
+            return;
+        }
+    }
+    for (hal_size_t first = 0; first < numTop; first += SegmentBlockSize) {
+        block._type = CopyBlock::TOP;
+        inGenome->getSegmentBlock(true, first, min(SegmentBlockSize, numTop - first), block._segments);
+        if (not queue.push(block)) {
+            return;
+        }
+    }
+    for (hal_size_t first = 0; first < numBottom; first += SegmentBlockSize) {
+        block._type = CopyBlock::BOTTOM;
+        inGenome->getSegmentBlock(false, first, min(SegmentBlockSize, numBottom - first), block._segments);
+        if (outRoot) {
+            fill(block._segments._parseIndexes.begin(), block._segments._parseIndexes.end(), NULL_INDEX);
+        }
+        if (not queue.push(block)) {
+            return;
+        }
+    }
+}
+
+/* write a block to the copy of a genome, returning its size in bytes */
+static size_t writeBlock(Genome *outGenome, const CopyBlock &block) {
+    if (block._type == CopyBlock::DNA) {
+        outGenome->setSubString(block._dna, block._start, block._dna.length());
+        return block._dna.length();
+    } else {
+        outGenome->setSegmentBlock(block._type == CopyBlock::TOP, block._segments);
+        return block._segments.getBytes();
+    }
+}
+
+/* Copy the DNA and segments of a genome to its copy, which has already been
+ * given its dimensions.  Blocks are read in another thread while this one
+ * writes them.  Returns the number of bytes copied. */
+size_t copyGenome(const Genome *inGenome, Genome *outGenome) {
+    hal_size_t numTop = outGenome->getNumTopSegments();
+    hal_size_t numBottom = outGenome->getNumBottomSegments();
+    assert(inGenome->getSequenceLength() == outGenome->getSequenceLength());
+    assert(numTop == 0 || numTop == inGenome->getNumTopSegments());
+    assert(numBottom == 0 || numBottom == inGenome->getNumBottomSegments());
+    assert(inGenome->getNumChildren() == outGenome->getNumChildren());
+    bool outRoot = outGenome->getAlignment()->getRootName() == outGenome->getName();
+
+    BlockQueue queue(QueueBlocks);
+    future<void> reader = async(launch::async, [&]() {
+        try {
+            readGenome(inGenome, numTop, numBottom, outRoot, queue);
+        } catch (...) {
+            queue.close();
+            throw;
+        }
+        queue.close();
+    });
+    size_t bytes = 0;
+    try {
+        CopyBlock block;
+        while (queue.pop(block)) {
+            bytes += writeBlock(outGenome, block);
+        }
+    } catch (...) {
+        queue.close();
+        reader.wait();
+        throw;
     }
+    reader.get();
+    return bytes;
+}
+
+/* size in MB and rate in MB/s of a copy */
+static string formatThroughput(size_t bytes, double seconds) {
+    ostringstream os;
+    double megabytes = bytes / 1e6;
+    os << fixed << setprecision(1) << megabytes << " MB in " << seconds << " s ("
+       << (seconds > 0 ? megabytes / seconds : 0.0) << " MB/s)";
+    return os.str();
 }
 
 static void closeWithNeighbours(AlignmentConstPtr alignment, const Genome* genome) {
@@ -184,23 +305,52 @@ static void extractTree(AlignmentConstPtr inAlignment, AlignmentPtr outAlignment
     }
 }
 
-void extract(AlignmentConstPtr inAlignment, AlignmentPtr outAlignment, const string &rootName) {
-    const Genome *genome = inAlignment->openGenome(rootName);
-    Genome *newGenome = outAlignment->openGenome(rootName);
-    assert(newGenome != NULL);
-
-    vector<Sequence::Info> dimensions;
-    getDimensions(inAlignment, genome, dimensions);
-    newGenome->setDimensions(dimensions);
+/* names of the genomes of a subtree, in pre-order */
+static void getSubtreeNames(AlignmentConstPtr alignment, const string &rootName, vector<string> &names) {
+    names.push_back(rootName);
+    for (const string &childName : alignment->getChildNames(rootName)) {
+        getSubtreeNames(alignment, childName, names);
+    }
+}
 
-    cout << "Extracting " << genome->getName() << endl;
-    copyGenome(genome, newGenome);
+/* Copy genomes numThreads at a time.  Opening, sizing and closing genomes
+ * isn't thread-safe, so it is done between the concurrent copies. */
+void extract(AlignmentConstPtr inAlignment, AlignmentPtr outAlignment, const string &rootName, size_t numThreads) {
+    vector<string> names;
+    getSubtreeNames(inAlignment, rootName, names);
+    size_t totalBytes = 0;
+    auto totalStart = chrono::steady_clock::now();
+    for (size_t first = 0; first < names.size(); first += numThreads) {
+        size_t end = min(first + numThreads, names.size());
+        vector<future<pair<size_t, double>>> copies;
+        for (size_t i = first; i < end; ++i) {
+            const Genome *genome = inAlignment->openGenome(names[i]);
+            Genome *newGenome = outAlignment->openGenome(names[i]);
+            assert(newGenome != NULL);
 
-    closeWithNeighbours(inAlignment, genome);
-    closeWithNeighbours(outAlignment, newGenome);
+            vector<Sequence::Info> dimensions;
+            getDimensions(inAlignment, genome, dimensions);
+            newGenome->setDimensions(dimensions);
+            genome->copyMetadata(newGenome);
 
-    vector<string> childNames = inAlignment->getChildNames(rootName);
-    for (size_t i = 0; i < childNames.size(); ++i) {
-        extract(inAlignment, outAlignment, childNames[i]);
+            cout << "Extracting " << genome->getName() << endl;
+            copies.push_back(async(launch::async, [genome, newGenome]() {
+                auto start = chrono::steady_clock::now();
+                size_t bytes = copyGenome(genome, newGenome);
+                return make_pair(bytes, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+            }));
+        }
+        for (size_t i = first; i < end; ++i) {
+            pair<size_t, double> copied = copies[i - first].get();
+            totalBytes += copied.first;
+            cout << "Extracted " << names[i] << ": " << formatThroughput(copied.first, copied.second) << endl;
+        }
+        // genomes are looked up again as closing one can close its neighbours
+        for (size_t i = first; i < end; ++i) {
+            closeWithNeighbours(inAlignment, inAlignment->openGenome(names[i]));
+            closeWithNeighbours(outAlignment, outAlignment->openGenome(names[i]));
+        }
     }
+    double totalSeconds = chrono::duration<double>(chrono::steady_clock::now() - totalStart).count();
+    cout << "Extracted " << names.size() << " genomes: " << formatThroughput(totalBytes, totalSeconds) << endl;
 }
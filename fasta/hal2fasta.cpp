@@ -95,6 +95,7 @@ int main(int argc, char **argv) {
         if (alignment->getNumGenomes() == 0) {
             throw hal_exception("input hal alignmenet is empty");
         }
+        alignment->setAccessPattern(ACCESS_SEQUENTIAL);
 
         ofstream ofile;
         ostream &outStream = faPath == "stdout" ? cout : ofile;
@@ -174,6 +175,7 @@ void printSequence(ostream &outStream, const Sequence *sequence, hal_size_t line
                             "out of range for sequence " + sequence->getName() + ", which has length " +
                             std::to_string(seqLen));
     }
+    sequence->getGenome()->setAccessPattern(ACCESS_WILLNEED, sequence->getStartPosition() + start, length);
     outStream << '>' << (fullNames ? sequence->getFullName() : sequence->getName()) << '\n';
     hal_size_t readLen;
     string buffer;
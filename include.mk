@@ -53,9 +53,9 @@ ifeq (${CXX_ABI_DEF},)
 endif
 
 CFLAGS += -I${sonLibDir}
-CXXFLAGS += -I${sonLibDir} ${CXX_ABI_DEF} -std=c++11 -Wno-sign-compare
+CXXFLAGS += -I${sonLibDir} ${CXX_ABI_DEF} -std=c++11 -Wno-sign-compare -pthread
 
-LDLIBS += ${sonLibDir}/sonLib.a ${sonLibDir}/cuTest.a
+LDLIBS += ${sonLibDir}/sonLib.a ${sonLibDir}/cuTest.a -pthread
 LIBDEPENDS += ${sonLibDir}/sonLib.a ${sonLibDir}/cuTest.a
 
 # hdf5 compilation is done through its wrappers.  See README.md for discussion of
@@ -92,6 +92,7 @@ int main(int argc, char **argv) {
         if (alignment->getNumGenomes() == 0) {
             throw hal_exception("hal alignment is empty");
         }
+        alignment->setAccessPattern(ACCESS_RANDOM);
 
         const Genome *srcGenome = alignment->openGenome(srcGenomeName);
         if (srcGenome == NULL) {
@@ -37,6 +37,9 @@ def getHal2MafCmd(options):
                 cmd += ' --%s %s' % (opt, str(val))
             else:
                 cmd += ' --%s' % opt
+    if options.hdf5CacheBudget is not None:
+        # the budget is for all of the hal2maf processes together
+        cmd += ' --hdf5CacheBudget %d' % max(1, options.hdf5CacheBudget // options.numProc)
     if options.smallFile and not options.firstSmallFile:
         cmd += ' --append'
     return cmd
@@ -248,6 +251,12 @@ def main():
     hdf5Grp.add_argument("--cacheW0",
                          help="w0 parameter fro hdf5 cache", type=float,
                          default=None)
+    hdf5Grp.add_argument("--hdf5CacheBudget",
+                         help="maximum size in bytes of the regular hdf5 "
+                         "caches, shared between all --numProc processes "
+                         "(ignored if --cacheBytes or --cacheRDC is given)",
+                         type=int,
+                         default=None)
     hdf5Grp.add_argument("--hdf5InMemory",
                          help="load all data in memory (& disable hdf5 cache)",
                          action="store_true",
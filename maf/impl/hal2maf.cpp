@@ -265,6 +265,7 @@ int main(int argc, char **argv) {
         if (alignment->getNumGenomes() == 0) {
             throw hal_exception("hal alignmenet is empty");
         }
+        alignment->setAccessPattern(ACCESS_SEQUENTIAL);
 
         hal2maf(alignment, opts);
     } catch (hal_exception &e) {
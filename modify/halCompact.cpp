@@ -0,0 +1,61 @@
+// Rewrite an mmap hal file without the space left behind by modifications
+#include "hal.h"
+#include <cstdio>
+#include <sys/stat.h>
+
+using namespace hal;
+using namespace std;
+
+static void initParser(CLParser &optionsParser) {
+    optionsParser.setDescription("Copy the live data of an mmap hal file to a new file, storing each genome "
+                                 "contiguously in tree order.  Reclaims the space left behind when a file is modified.");
+    optionsParser.addArgument("halFile", "mmap hal file to compact");
+    optionsParser.addOption("outFile", "write the compacted alignment to this file rather than replacing halFile", "");
+    optionsParser.addOption("mmapFileSize", "initial size of the new file (in gigabytes), the file is grown as needed",
+                            MMAP_DEFAULT_FILE_SIZE_GB);
+}
+
+static size_t getFileSize(const string &path) {
+    struct stat statBuf;
+    if (stat(path.c_str(), &statBuf) < 0) {
+        throw hal_errno_exception(path, "stat failed", errno);
+    }
+    return statBuf.st_size;
+}
+
+int main(int argc, char *argv[]) {
+    CLParser optionsParser;
+    initParser(optionsParser);
+    string halPath, outPath;
+    size_t fileSizeGb;
+    try {
+        optionsParser.parseOptions(argc, argv);
+        halPath = optionsParser.getArgument<string>("halFile");
+        outPath = optionsParser.getOption<string>("outFile");
+        fileSizeGb = optionsParser.getOption<size_t>("mmapFileSize");
+    } catch (exception &e) {
+        cerr << e.what() << endl;
+        optionsParser.printUsage(cerr);
+        return 1;
+    }
+
+    try {
+        if (detectHalAlignmentFormat(halPath) != STORAGE_FORMAT_MMAP) {
+            throw hal_exception(halPath + " is not an mmap hal file");
+        }
+        // compact in place by replacing the file once the copy is complete
+        bool inPlace = outPath.empty();
+        string compactPath = inPlace ? halPath + ".compact.tmp" : outPath;
+        size_t oldSize = getFileSize(halPath);
+        mmapCompactAlignment(halPath, compactPath, fileSizeGb * GIGABYTE);
+        size_t newSize = getFileSize(compactPath);
+        if (inPlace && (rename(compactPath.c_str(), halPath.c_str()) < 0)) {
+            throw hal_errno_exception(compactPath, "rename to " + halPath + " failed", errno);
+        }
+        cout << "Compacted " << halPath << " from " << oldSize << " to " << newSize << " bytes" << endl;
+    } catch (exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -55,6 +55,7 @@ int main(int argc, char **argv) {
         if (alignment->getNumGenomes() == 0) {
             throw hal_exception("input hal alignmenet is empty");
         }
+        alignment->setAccessPattern(ACCESS_SEQUENTIAL);
         
         // root is specified either by the parameter or as the alignment root
         // by default
@@ -29,6 +29,7 @@ int main(int argc, char **argv) {
     }
     try {
         AlignmentConstPtr alignment(openHalAlignment(path, &optionsParser));
+        alignment->setAccessPattern(ACCESS_SEQUENTIAL);
         if (genomeName == "") {
             validateAlignment(alignment.get());
         } else {